@@ -32,7 +32,7 @@
 #define LIBCSOUP_VERSION(x,y,z)	(((x)<<24)|((y)<<12)|(z))
 #define LIBCSOUP_VER_MAJOR	0		/* 0-255 */
 #define LIBCSOUP_VER_MINOR	9		/* 0-4095 */
-#define LIBCSOUP_VER_BUGFIX	10		/* 0-4095 */
+#define LIBCSOUP_VER_BUGFIX	11		/* 0-4095 */
 
 
 /* Forward declaration the structure of circular doubly linked list to hide
@@ -181,6 +181,7 @@ slog(int control_word, char *fmt, ...);
 typedef int	(*F_LCK)(void *);
 typedef int	(*F_PREFIX)(int cw, char *buf, int);
 typedef	int	(*F_EXT)(void *, void *, char *);
+typedef	int	(*F_ASYNC)(void *, int, char *, char *);
 
 typedef	struct	{
 	int	magic;
@@ -205,6 +206,10 @@ typedef	struct	{
 	void	*lock;
 	F_LCK	f_lock;
 	F_LCK	f_unlock;
+
+	/* the asynchronous output extension */
+	F_ASYNC	f_async;
+	void	*asyncobj;
 } SMMDBG;
 
 
@@ -221,12 +226,14 @@ int slog_translate_setup(SMMDBG *dbgc, int which, F_PREFIX func);
 int slog_translate_remove(SMMDBG *dbgc, int which, F_PREFIX func);
 int slog_translating(SMMDBG *dbgc, int which, int cw, char *buf, int blen);
 int slog_output(SMMDBG *dbgc, int cw, char *buf);
+int slog_write(SMMDBG *dbgc, char *prefix, char *buf, int flush);
 int slogs(SMMDBG *dbgc, int cw, char *buf);
 int slogs_long(SMMDBG *dbgc, int setcw, int cw, char *buf);
 int slogf(SMMDBG *dbgc, int cw, char *fmt, ...);
 int slogf_long(SMMDBG *dbgc, int setcw, int cw, char *fmt, ...);
 int slog_validate(SMMDBG *dbgc, int setcw, int cw);
 void *slog_bind_tcp(SMMDBG *dbgc, int port);
+void *slog_bind_async(SMMDBG *dbgc, int records, int flush);
 
 #ifdef __cplusplus
 } // __cplusplus defined.
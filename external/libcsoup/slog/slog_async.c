@@ -0,0 +1,271 @@
+
+/*  slog_async.c - the asynchronous output of slog
+
+    Copyright (C) 2018  "Andy Xuming" <xuming@users.sourceforge.net>
+
+    This file is part of CSOUP, Chicken Soup library
+
+    CSOUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    CSOUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* The preformatted records are put into a bounded ring by any number of
+ * threads and drained by one writer thread. The ring is the lock-free
+ * queue of Dmitry Vyukov: each record has a sequence number telling the
+ * producers and the consumer whose turn it is. The producers only race
+ * on the tail by compare-and-swap. When the ring is full, the producers
+ * wait for the writer, so no records are lost */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libcsoup.h"
+
+#ifdef	CFG_UNIX_API
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#define SLOG_REC_INLINE		240	/* short records are stored inline */
+#define SLOG_ASYNC_IDLE		5	/* idle time of the writer (ms) */
+
+struct	slog_record	{
+	unsigned	seq;		/* the turn of the record */
+	int		cw;
+	char		*text;		/* points to 'buf' or allocated */
+	char		buf[SLOG_REC_INLINE];
+};
+
+struct	slog_async	{
+	SMMDBG		*dbgc;
+	pthread_t	writer;
+	pthread_mutex_t	lock;		/* only for waking up the writer */
+	pthread_cond_t	cond;
+	int		quit;
+	int		flush;		/* the flush policy, see slog_bind_async */
+	unsigned	mask;		/* records - 1 */
+	unsigned	tail;		/* the next record to produce */
+	unsigned	head;		/* the next record to consume */
+	struct	slog_record	rec[1];
+};
+
+static int slog_async_output(void *maindbg, int cw, char *prefix, char *buf);
+static void *slog_async_writer(void *self);
+static int slog_async_drain(struct slog_async *aobj);
+static int slog_unbind_async(SMMDBG *dbgc);
+
+
+/* bind the asynchronous output to the control block. 'records' is the
+ * size of the ring, which is rounded up to the power of 2. 'flush' is the
+ * flush policy: 0 flushes the outputs when the ring was drained; N > 0
+ * flushes the outputs no more than once in N milliseconds; -1 leaves it
+ * to the stdio. The error records are always flushed */
+void *slog_bind_async(SMMDBG *dbgc, int records, int flush)
+{
+	struct	slog_async	*aobj;
+	unsigned	i, n;
+
+	if (dbgc->f_async) {
+		slog_unbind_async(dbgc);
+	}
+	if (records <= 0) {
+		return NULL;	/* unbind */
+	}
+	for (n = 2; n < (unsigned) records; n <<= 1);
+
+	aobj = smm_alloc(sizeof(struct slog_async) +
+			sizeof(struct slog_record) * (n - 1));
+	if (aobj == NULL) {
+		return NULL;
+	}
+	aobj->dbgc  = dbgc;
+	aobj->flush = flush;
+	aobj->mask  = n - 1;
+	for (i = 0; i < n; i++) {
+		aobj->rec[i].seq = i;
+	}
+	pthread_mutex_init(&aobj->lock, NULL);
+	pthread_cond_init(&aobj->cond, NULL);
+	if (pthread_create(&aobj->writer, NULL, slog_async_writer, aobj)) {
+		pthread_cond_destroy(&aobj->cond);
+		pthread_mutex_destroy(&aobj->lock);
+		smm_free(aobj);
+		return NULL;
+	}
+
+	dbgc->asyncobj = aobj;
+	__atomic_store_n(&dbgc->f_async, slog_async_output, __ATOMIC_RELEASE);
+	return aobj;
+}
+
+/* the producer: it's called by slog_output() in any thread */
+static int slog_async_output(void *maindbg, int cw, char *prefix, char *buf)
+{
+	SMMDBG	*dbgc = maindbg;
+	struct	slog_async	*aobj = dbgc->asyncobj;
+	struct	slog_record	*rec;
+	unsigned	pos, seq;
+	int	plen, blen;
+
+	if ((prefix == NULL) || (buf == NULL)) {
+		return slog_unbind_async(dbgc);
+	}
+
+	/* claim a record in the ring */
+	pos = __atomic_load_n(&aobj->tail, __ATOMIC_RELAXED);
+	for ( ; ; ) {
+		rec = &aobj->rec[pos & aobj->mask];
+		seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+		if (seq == pos) {
+			if (__atomic_compare_exchange_n(&aobj->tail, &pos,
+					pos + 1, 1, __ATOMIC_RELAXED,
+					__ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if ((int)(seq - pos) < 0) {
+			/* the ring is full; wake up the writer and wait */
+			pthread_cond_signal(&aobj->cond);
+			sched_yield();
+			pos = __atomic_load_n(&aobj->tail, __ATOMIC_RELAXED);
+		} else {
+			pos = __atomic_load_n(&aobj->tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	/* fill the record and hand it over to the writer */
+	plen = strlen(prefix);
+	blen = strlen(buf);
+	rec->cw = cw;
+	rec->text = rec->buf;
+	if (plen + blen >= SLOG_REC_INLINE) {
+		if ((rec->text = malloc(plen + blen + 1)) == NULL) {
+			/* truncate the record to the inline buffer */
+			rec->text = rec->buf;
+			if (plen >= SLOG_REC_INLINE) {
+				plen = SLOG_REC_INLINE - 1;
+			}
+			blen = SLOG_REC_INLINE - plen - 1;
+		}
+	}
+	memcpy(rec->text, prefix, plen);
+	memcpy(rec->text + plen, buf, blen);
+	rec->text[plen + blen] = 0;
+	__atomic_store_n(&rec->seq, pos + 1, __ATOMIC_RELEASE);
+
+	if (SLOG_LEVEL_GET(cw) <= SLOG_LVL_ERROR) {
+		pthread_cond_signal(&aobj->cond);
+	}
+	return 0;
+}
+
+static void *slog_async_writer(void *self)
+{
+	struct	slog_async	*aobj = self;
+	struct	timespec	ts;
+	SMM_TIME	tmark;
+	int	n, dirty = 0;
+
+	smm_time_get_epoch(&tmark);
+	for ( ; ; ) {
+		n = slog_async_drain(aobj);
+		if (n > 0) {
+			dirty = 1;
+		}
+		if (dirty && (n <= 0) && ((aobj->flush == 0) ||
+				((aobj->flush > 0) &&
+				 (smm_time_diff(&tmark) >= aobj->flush)))) {
+			/* the error records were flushed by the drain */
+			slog_write(aobj->dbgc, NULL, NULL, 1);
+			smm_time_get_epoch(&tmark);
+			dirty = 0;
+		}
+		if (n != 0) {
+			continue;
+		}
+		if (__atomic_load_n(&aobj->quit, __ATOMIC_ACQUIRE)) {
+			break;
+		}
+
+		/* the producers don't take the lock so the writer could
+		 * miss a signal; the timed wait would pick it up */
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += SLOG_ASYNC_IDLE * 1000000L;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+		pthread_mutex_lock(&aobj->lock);
+		pthread_cond_timedwait(&aobj->cond, &aobj->lock, &ts);
+		pthread_mutex_unlock(&aobj->lock);
+	}
+	slog_write(aobj->dbgc, NULL, NULL, 1);
+	return NULL;
+}
+
+/* the consumer: it writes the ready records in order and returns the
+ * number of records. A record claimed but not filled stops the drain */
+static int slog_async_drain(struct slog_async *aobj)
+{
+	struct	slog_record	*rec;
+	unsigned	seq;
+	int	n;
+
+	for (n = 0; ; n++, aobj->head++) {
+		rec = &aobj->rec[aobj->head & aobj->mask];
+		seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+		if (seq != aobj->head + 1) {
+			break;
+		}
+		slog_write(aobj->dbgc, NULL, rec->text,
+				SLOG_LEVEL_GET(rec->cw) <= SLOG_LVL_ERROR);
+		if (rec->text != rec->buf) {
+			free(rec->text);
+		}
+		/* release the record to the next round of producers */
+		__atomic_store_n(&rec->seq, aobj->head + aobj->mask + 1,
+				__ATOMIC_RELEASE);
+	}
+	return n;
+}
+
+/* stop taking records and let the writer drain the ring. It should be 
+ * called after other threads stopped logging */
+static int slog_unbind_async(SMMDBG *dbgc)
+{
+	struct	slog_async	*aobj = dbgc->asyncobj;
+
+	__atomic_store_n(&dbgc->f_async, NULL, __ATOMIC_RELEASE);
+	if (aobj == NULL) {
+		return 0;
+	}
+	dbgc->asyncobj = NULL;
+
+	__atomic_store_n(&aobj->quit, 1, __ATOMIC_RELEASE);
+	pthread_cond_signal(&aobj->cond);
+	pthread_join(aobj->writer, NULL);
+	slog_async_drain(aobj);		/* the records of the late comers */
+	pthread_cond_destroy(&aobj->cond);
+	pthread_mutex_destroy(&aobj->lock);
+	smm_free(aobj);
+	return 0;
+}
+#else	/* CFG_WIN32_API */
+void *slog_bind_async(SMMDBG *dbgc, int records, int flush)
+{
+	/* not supported yet; slog_output() writes synchronously */
+	(void) dbgc; (void) records; (void) flush;
+	return NULL;
+}
+#endif
+
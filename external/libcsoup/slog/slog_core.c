@@ -44,6 +44,13 @@ SMMDBG *slog_initialize(void *mem, int cword)
 
 int slog_shutdown(SMMDBG *dbgc)
 {
+	F_ASYNC	f_async;
+
+	/* drain the asynchronous records before closing the outputs */
+	f_async = __atomic_load_n(&dbgc->f_async, __ATOMIC_ACQUIRE);
+	if (f_async) {
+		f_async(dbgc, 0, NULL, NULL);
+	}
 	slog_unbind_file(dbgc);
 
 	if (dbgc->f_inet) {
@@ -153,6 +160,7 @@ int slog_translating(SMMDBG *dbgc, int which, int cw, char *buf, int blen)
 
 int slog_output(SMMDBG *dbgc, int cw, char *buf)
 {
+	F_ASYNC	f_async;
 	char	prefix[512];
 	int	len;
 
@@ -184,37 +192,63 @@ int slog_output(SMMDBG *dbgc, int cw, char *buf)
 		len += strlen(prefix);
 	}
 
+	/* 20181018 the asynchronous output takes the preformatted record 
+	 * and writes it in the background. The hook can be unbound by
+	 * another thread so it is loaded only once */
+	f_async = __atomic_load_n(&dbgc->f_async, __ATOMIC_ACQUIRE);
+	if ((f_async == NULL) || f_async(dbgc, cw, prefix, buf)) {
+		slog_write(dbgc, prefix, buf, 1);
+	}
+
+	if (dbgc->f_unlock) {
+		dbgc->f_unlock(dbgc);
+	}
+	return len;
+}
+
+/* write the prefix and the message into the outputs. If 'flush' is set, 
+ * the outputs are flushed afterward. NULL in both 'prefix' and 'buf' 
+ * only flushes the outputs */
+int slog_write(SMMDBG *dbgc, char *prefix, char *buf, int flush)
+{
+	FILE	*stdio;
+
+	stdio = (dbgc->stdio == (void*) -1) ? stdout : dbgc->stdio;
+	if (prefix && (prefix[0] == 0)) {
+		prefix = NULL;
+	}
+
 	if (dbgc->logd) {
-		if (prefix[0]) {
+		if (prefix) {
 			fputs(prefix, dbgc->logd);
 		}
-		fputs(buf, dbgc->logd);
-		fflush(dbgc->logd);
+		if (buf) {
+			fputs(buf, dbgc->logd);
+		}
+		if (flush) {
+			fflush(dbgc->logd);
+		}
 	}
-	if (dbgc->stdio == (void*) -1) {
-		if (prefix[0]) {
-			fputs(prefix, stdout);
+	if (stdio) {
+		if (prefix) {
+			fputs(prefix, stdio);
 		}
-		fputs(buf, stdout);
-		fflush(stdout);
-	} else if (dbgc->stdio) {
-		if (prefix[0]) {
-			fputs(prefix, dbgc->stdio);
+		if (buf) {
+			fputs(buf, stdio);
+		}
+		if (flush) {
+			fflush(stdio);
 		}
-		fputs(buf, dbgc->stdio);
-		fflush(dbgc->stdio);
 	}
 	if (dbgc->f_inet) {
-		if (prefix[0]) {
+		if (prefix) {
 			dbgc->f_inet(dbgc, dbgc->netobj, prefix);
 		}
-		dbgc->f_inet(dbgc, dbgc->netobj, buf);
-	}
-
-	if (dbgc->f_unlock) {
-		dbgc->f_unlock(dbgc);
+		if (buf) {
+			dbgc->f_inet(dbgc, dbgc->netobj, buf);
+		}
 	}
-	return len;
+	return 0;
 }
 
 int slogs(SMMDBG *dbgc, int cw, char *buf)
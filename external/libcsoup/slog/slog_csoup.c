@@ -36,7 +36,8 @@ SMMDBG	csoup_debug_control = {
 	{ slog_csoup_trans_module },
 	{ slog_csoup_trans_date },
 	NULL, NULL,			/* socket extension */
-	NULL, NULL, NULL		/* mutex setting */
+	NULL, NULL, NULL,		/* mutex setting */
+	NULL, NULL			/* asynchronous extension */
 };
 
 
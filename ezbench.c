@@ -0,0 +1,556 @@
+/*  ezbench.c - the benchmark of ezthumb by synthetic clips
+
+    Copyright (C) 2018  "Andy Xuming" <xuming@users.sourceforge.net>
+
+    This file is part of EZTHUMB, a utility to generate thumbnails
+
+    EZTHUMB is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    EZTHUMB is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Usage: ezbench [corpus_directory]
+ *
+ * The ezbench generates a corpus of synthetic clips by libavcodec and
+ * libavformat if they are not in the corpus directory yet, then runs every
+ * process mode and duration mode against every clip. Each run is forked
+ * into a child process so the peak RSS is measured alone. The result is
+ * a table of the wall time, bytes read, packets decoded and the peak RSS.
+ * Then it checks the one-pass mode against the two-pass mode, which must
+ * take the same frames, and returns 1 if they were different. At last it
+ * measures the scaling time per shot and the PSNR against the Lanczos
+ * of every quality tier of the scaler.
+ * It works in the POSIX systems only. See 'make bench' */
+
+#ifdef  HAVE_CONFIG_H
+#include <config.h>
+#else
+#error "Run configure first"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "ezthumb.h"
+#include "id_lookup.h"
+
+/* re-use the debug convention in libcsoup */
+#define CSOUP_DEBUG_LOCAL     SLOG_CWORD(EZTHUMB_MOD_CLI, SLOG_LVL_WARNING)
+#include "libcsoup_debug.h"
+
+#ifndef	AV_CODEC_FLAG_GLOBAL_HEADER
+#define AV_CODEC_FLAG_GLOBAL_HEADER	CODEC_FLAG_GLOBAL_HEADER
+#endif
+
+#define EZB_FPS		25
+#define EZB_DEF_DIR	"bench_clips"
+#define EZB_SHOTS	64	/* the shots recorded for comparing */
+
+struct	ezbclip	{
+	char	*name;
+	char	*format;	/* short name of the muxer */
+	int	codec;
+	int	width;
+	int	height;
+	int	gop;		/* 0 means the single key frame */
+	int	bframes;
+	int	seconds;
+};
+
+static	struct	ezbclip	clips[] = {
+	{ "gop12_320x240.mp4", "mp4", AV_CODEC_ID_MPEG4,
+		320, 240, 12, 0, 120 },
+	{ "gop250_640x360.mkv", "matroska", AV_CODEC_ID_MPEG4,
+		640, 360, 250, 2, 120 },
+	{ "gop25_720x576.ts", "mpegts", AV_CODEC_ID_MPEG2VIDEO,
+		720, 576, 25, 2, 90 },
+	{ "gop50_1280x720.avi", "avi", AV_CODEC_ID_MPEG4,
+		1280, 720, 50, 0, 60 },
+	{ "onekey_640x360.mp4", "mp4", AV_CODEC_ID_MPEG4,
+		640, 360, 0, 0, 60 },
+	{ NULL, NULL, 0, 0, 0, 0, 0, 0 }
+};
+
+static	struct	idtbl	modes_proc[] = {
+	{ EZOP_PROC_SKIM,    "skim" },
+	{ EZOP_PROC_SCAN,    "scan" },
+	{ EZOP_PROC_TWOPASS, "2pass" },
+	{ EZOP_PROC_ONEPASS, "1pass" },
+	{ EZOP_PROC_SAFE,    "safe" },
+	{ EZOP_PROC_KEYRIP,  "key" },
+	{ 0, NULL }
+};
+
+static	struct	idtbl	modes_scale[] = {
+	{ EZOP_SCALE_FAST,     "fast" },
+	{ EZOP_SCALE_BALANCED, "balanced" },
+	{ EZOP_SCALE_BEST,     "best" },
+	{ EZOP_SCALE_AUTO,     "auto" },
+	{ 0, NULL }
+};
+
+static	struct	idtbl	modes_dur[] = {
+	{ EZOP_DUR_HEAD,  "head" },
+	{ EZOP_DUR_QSCAN, "fast" },
+	{ EZOP_DUR_FSCAN, "scan" },
+	{ 0, NULL }
+};
+
+struct	ezbres	{
+	int	rc;
+	EZSTAT	stat;
+	int	shots;			/* the shots taken */
+	int64_t	pts[EZB_SHOTS];		/* the PTS of each shot */
+};
+
+/* the result of the running child */
+static	struct	ezbres	*bench_res;
+
+static int bench_clip_make(struct ezbclip *clip, char *path);
+static int bench_clip_encode(AVFormatContext *fmtx, AVStream *st,
+		AVCodecContext *codecx, AVFrame *frame);
+static void bench_clip_paint(AVFrame *frame, int idx);
+static int bench_run(char *path, char *outdir, int proc, int dur,
+		int scale, struct ezbres *res, long *rss);
+static int bench_onepass(char *path, char *outdir, char *name);
+static int bench_scaler(char *path, char *outdir, char *name);
+static int bench_event(void *vobj, int event, long param, long opt, void *);
+
+
+int main(int argc, char **argv)
+{
+	struct	ezbres	res;
+	SMM_TIME	tmark;
+	char	*corpus, path[1024], outdir[1024];
+	long	rss;
+	int	i, p, d, wall, diff;
+
+	corpus = argc > 1 ? argv[1] : EZB_DEF_DIR;
+
+	smm_init();
+	slog_csoup_open(NULL, NULL);
+	avcodec_register_all();
+	av_register_all();
+	if (gdFTUseFontConfig(1) == 0) {
+		ezttf_open();
+	}
+
+	snprintf(outdir, sizeof(outdir), "%s/out", corpus);
+	if ((mkdir(corpus, 0755) < 0) && (errno != EEXIST)) {
+		perror(corpus);
+		return -1;
+	}
+	if ((mkdir(outdir, 0755) < 0) && (errno != EEXIST)) {
+		perror(outdir);
+		return -1;
+	}
+
+	/* generate the clips which are not in the corpus */
+	for (i = 0; clips[i].name; i++) {
+		snprintf(path, sizeof(path), "%s/%s", corpus, clips[i].name);
+		if (access(path, R_OK) == 0) {
+			continue;
+		}
+		printf("Generating %s ... ", path);
+		fflush(stdout);
+		if (bench_clip_make(&clips[i], path) < 0) {
+			printf("failed\n");
+			unlink(path);
+		} else {
+			printf("done\n");
+		}
+	}
+
+	printf("\n%-20s %-5s %-4s %9s %12s %8s %9s\n", "CLIP", "PROC", "DUR",
+			"WALL(ms)", "BYTES", "PACKETS", "RSS(KB)");
+	for (i = 0; clips[i].name; i++) {
+		snprintf(path, sizeof(path), "%s/%s", corpus, clips[i].name);
+		if (access(path, R_OK) < 0) {
+			continue;
+		}
+		for (p = 0; modes_proc[p].s; p++) {
+			for (d = 0; modes_dur[d].s; d++) {
+				smm_time_get_epoch(&tmark);
+				bench_run(path, outdir, modes_proc[p].id,
+					modes_dur[d].id, -1, &res, &rss);
+				wall = smm_time_diff(&tmark);
+				printf("%-20s %-5s %-4s ", clips[i].name,
+						modes_proc[p].s,
+						modes_dur[d].s);
+				if (res.rc < 0) {
+					printf("%9d %12s %8s %9ld  error %d\n",
+						wall, "-", "-", rss, res.rc);
+				} else {
+					printf("%9d %12lld %8lu %9ld\n", wall,
+						(long long) res.stat.bytes,
+						res.stat.decoded, rss);
+				}
+				fflush(stdout);
+			}
+		}
+	}
+
+	/* the one-pass mode must take the same frames as the two-pass */
+	printf("\n%-20s %12s %12s %6s %6s  %s\n", "CLIP", "BYTES(2P)",
+			"BYTES(1P)", "SHOTS", "SAME", "RESULT");
+	for (i = diff = 0; clips[i].name; i++) {
+		snprintf(path, sizeof(path), "%s/%s", corpus, clips[i].name);
+		if (access(path, R_OK) == 0) {
+			diff += bench_onepass(path, outdir, clips[i].name);
+		}
+	}
+
+	/* the scaling time per shot and the PSNR against the Lanczos */
+	printf("\n%-20s %-8s %6s %10s %9s\n", "CLIP", "SCALE", "SHOTS",
+			"US/SHOT", "PSNR(dB)");
+	for (i = 0; clips[i].name; i++) {
+		snprintf(path, sizeof(path), "%s/%s", corpus, clips[i].name);
+		if (access(path, R_OK) == 0) {
+			bench_scaler(path, outdir, clips[i].name);
+		}
+	}
+
+	ezttf_close();
+	slog_csoup_close();
+	smm_destroy();
+	return diff ? 1 : 0;
+}
+
+static int bench_clip_make(struct ezbclip *clip, char *path)
+{
+	AVFormatContext	*fmtx = NULL;
+	AVCodecContext	*codecx;
+	AVStream	*st;
+	AVCodec		*codec;
+	AVFrame		*frame;
+	int		i, rc = -1;
+
+	if ((codec = avcodec_find_encoder(clip->codec)) == NULL) {
+		return -1;
+	}
+	if (avformat_alloc_output_context2(&fmtx, NULL, clip->format,
+				path) < 0) {
+		return -1;
+	}
+	if ((st = avformat_new_stream(fmtx, NULL)) == NULL) {
+		avformat_free_context(fmtx);
+		return -1;
+	}
+#ifdef	HAVE_AVS_CODECPAR
+	if ((codecx = avcodec_alloc_context3(codec)) == NULL) {
+		avformat_free_context(fmtx);
+		return -1;
+	}
+#else
+	codecx = st->codec;
+#endif
+	codecx->codec_id  = clip->codec;
+	codecx->width     = clip->width;
+	codecx->height    = clip->height;
+	codecx->pix_fmt   = AV_PIX_FMT_YUV420P;
+	codecx->time_base = (AVRational){ 1, EZB_FPS };
+	codecx->bit_rate  = clip->width * clip->height * 2;
+	codecx->max_b_frames = clip->bframes;
+	/* the single key frame clip has a GOP longer than the clip */
+	codecx->gop_size  = clip->gop ? clip->gop :
+			clip->seconds * EZB_FPS + 1;
+	st->time_base = codecx->time_base;
+	if (fmtx->oformat->flags & AVFMT_GLOBALHEADER) {
+		codecx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+	}
+	if (avcodec_open2(codecx, codec, NULL) < 0) {
+		goto clip_free;
+	}
+#ifdef	HAVE_AVS_CODECPAR
+	if (avcodec_parameters_from_context(st->codecpar, codecx) < 0) {
+		goto clip_free;
+	}
+#endif
+	if (!(fmtx->oformat->flags & AVFMT_NOFILE) &&
+			(avio_open(&fmtx->pb, path, AVIO_FLAG_WRITE) < 0)) {
+		goto clip_free;
+	}
+	if (avformat_write_header(fmtx, NULL) < 0) {
+		goto clip_close;
+	}
+
+	if ((frame = av_frame_alloc()) == NULL) {
+		goto clip_close;
+	}
+	frame->format = codecx->pix_fmt;
+	frame->width  = codecx->width;
+	frame->height = codecx->height;
+	if (av_frame_get_buffer(frame, 32) < 0) {
+		av_frame_free(&frame);
+		goto clip_close;
+	}
+	for (i = 0; i < clip->seconds * EZB_FPS; i++) {
+		if (av_frame_make_writable(frame) < 0) {
+			break;
+		}
+		bench_clip_paint(frame, i);
+		frame->pts = i;
+		if (bench_clip_encode(fmtx, st, codecx, frame) < 0) {
+			break;
+		}
+	}
+	av_frame_free(&frame);
+	if (i == clip->seconds * EZB_FPS) {
+		/* flush the delayed frames in the encoder */
+		while ((rc = bench_clip_encode(fmtx, st, codecx, NULL)) > 0);
+	}
+	av_write_trailer(fmtx);
+clip_close:
+	if (!(fmtx->oformat->flags & AVFMT_NOFILE)) {
+		avio_closep(&fmtx->pb);
+	}
+clip_free:
+#ifdef	HAVE_AVS_CODECPAR
+	avcodec_free_context(&codecx);
+#else
+	avcodec_close(codecx);
+#endif
+	avformat_free_context(fmtx);
+	return rc;
+}
+
+/* encode a frame, or flush the encoder if the frame is NULL.
+ * It returns the number of written packets or the error code */
+static int bench_clip_encode(AVFormatContext *fmtx, AVStream *st,
+		AVCodecContext *codecx, AVFrame *frame)
+{
+	AVPacket	packet;
+	int		rc, n = 0;
+
+	av_init_packet(&packet);
+	packet.data = NULL;
+	packet.size = 0;
+#ifdef	HAVE_AVCODEC_RECEIVE_FRAME
+	if ((rc = avcodec_send_frame(codecx, frame)) < 0) {
+		return rc == AVERROR_EOF ? 0 : rc;
+	}
+	while ((rc = avcodec_receive_packet(codecx, &packet)) >= 0) {
+		av_packet_rescale_ts(&packet, codecx->time_base, st->time_base);
+		packet.stream_index = st->index;
+		if ((rc = av_interleaved_write_frame(fmtx, &packet)) < 0) {
+			return rc;
+		}
+		n++;
+	}
+	if ((rc != AVERROR(EAGAIN)) && (rc != AVERROR_EOF)) {
+		return rc;
+	}
+#else
+	int	got_packet = 0;
+
+	rc = avcodec_encode_video2(codecx, &packet, frame, &got_packet);
+	if (rc < 0) {
+		return rc;
+	}
+	if (got_packet) {
+		av_packet_rescale_ts(&packet, codecx->time_base, st->time_base);
+		packet.stream_index = st->index;
+		if ((rc = av_interleaved_write_frame(fmtx, &packet)) < 0) {
+			return rc;
+		}
+		n++;
+	}
+#endif
+	return n;
+}
+
+/* paint a moving gradient with a bouncing block so the encoder would
+ * have real motions to predict and the shots are distinguishable */
+static void bench_clip_paint(AVFrame *frame, int idx)
+{
+	unsigned char	*p;
+	int	x, y, bx, by, bs;
+
+	bs = frame->height / 4;
+	bx = (idx * 7) % (frame->width - bs);
+	by = (idx * 3) % (frame->height - bs);
+	for (y = 0; y < frame->height; y++) {
+		p = frame->data[0] + y * frame->linesize[0];
+		for (x = 0; x < frame->width; x++) {
+			if ((x >= bx) && (x < bx + bs) &&
+					(y >= by) && (y < by + bs)) {
+				p[x] = 235;
+			} else {
+				p[x] = (x + y + idx * 3) & 0xff;
+			}
+		}
+	}
+	for (y = 0; y < frame->height / 2; y++) {
+		p = frame->data[1] + y * frame->linesize[1];
+		memset(p, (128 + y + idx * 2) & 0xff, frame->width / 2);
+		p = frame->data[2] + y * frame->linesize[2];
+		memset(p, (64 + idx * 5) & 0xff, frame->width / 2);
+	}
+}
+
+/* compare the frames taken by the one-pass mode to the two-pass mode. 
+ * It returns 1 if any shot was different */
+static int bench_onepass(char *path, char *outdir, char *name)
+{
+	struct	ezbres	two, one;
+	long	rss;
+	int	i, n, same;
+
+	bench_run(path, outdir, EZOP_PROC_TWOPASS, EZOP_DUR_HEAD, -1, 
+			&two, &rss);
+	bench_run(path, outdir, EZOP_PROC_ONEPASS, EZOP_DUR_HEAD, -1, 
+			&one, &rss);
+	printf("%-20s ", name);
+	if ((two.rc < 0) || (one.rc < 0)) {
+		printf("%12s %12s %6s %6s  error %d/%d\n", "-", "-", "-", "-",
+				two.rc, one.rc);
+		return 1;
+	}
+	n = two.shots < EZB_SHOTS ? two.shots : EZB_SHOTS;
+	for (i = same = 0; i < n; i++) {
+		if ((i < one.shots) && (one.pts[i] == two.pts[i])) {
+			same++;
+		}
+	}
+	printf("%12lld %12lld %6d %6d  %s\n", (long long) two.stat.bytes,
+			(long long) one.stat.bytes, two.shots, same,
+			(one.shots == two.shots) && (same == n) ? 
+			"ok" : "DIFFERENT");
+	fflush(stdout);
+	return (one.shots == two.shots) && (same == n) ? 0 : 1;
+}
+
+/* take the shots by every quality tier of the scaler and print the 
+ * average scaling time and the PSNR against the Lanczos */
+static int bench_scaler(char *path, char *outdir, char *name)
+{
+	struct	ezbres	res;
+	long	rss;
+	int	i;
+
+	for (i = 0; modes_scale[i].s; i++) {
+		bench_run(path, outdir, EZOP_PROC_SKIM, EZOP_DUR_HEAD,
+				modes_scale[i].id, &res, &rss);
+		printf("%-20s %-8s ", name, modes_scale[i].s);
+		if ((res.rc < 0) || (res.stat.shots == 0)) {
+			printf("%6s %10s %9s  error %d\n", "-", "-", "-", 
+					res.rc);
+			continue;
+		}
+		printf("%6lu %10lld %9.2f\n", res.stat.shots,
+				(long long)(res.stat.t_scale / 
+					(int64_t) res.stat.shots),
+				res.stat.psnr_num ? 
+				res.stat.psnr / res.stat.psnr_num : 0.0);
+		fflush(stdout);
+	}
+	return 0;
+}
+
+/* run the ezthumb in a child process. The counters are sent back by
+ * the pipe and the peak RSS comes from the resource usage of the child.
+ * The 'scale' is the quality tier of the scaler to be measured against 
+ * the Lanczos, or -1 for the default scaler without measuring */
+static int bench_run(char *path, char *outdir, int proc, int dur,
+		int scale, struct ezbres *res, long *rss)
+{
+	EZOPT	ezopt;
+	struct	rusage	usage;
+	pid_t	pid;
+	int	fd[2], status;
+
+	memset(res, 0, sizeof(struct ezbres));
+	res->rc = EZ_ERR_LOWMEM;
+	*rss = 0;
+	if (pipe(fd) < 0) {
+		return res->rc;
+	}
+	if ((pid = fork()) < 0) {
+		close(fd[0]);
+		close(fd[1]);
+		return res->rc;
+	}
+	if (pid == 0) {
+		close(fd[0]);
+		ezopt_init(&ezopt, NULL);
+		EZOP_PROC_MAKE(ezopt.flags, proc);
+		SETDURMOD(ezopt.flags, dur);
+		EZOP_THUMB_SET(ezopt.flags, EZOP_THUMB_OVERRIDE);
+		if (proc == EZOP_PROC_KEYRIP) {
+			ezopt.grid_col = 0;
+			ezopt.grid_row = 0;
+		}
+		if (scale >= 0) {
+			EZOP_SCALE_SET(ezopt.flags, scale);
+			ezopt.scale_bench = 1;
+		}
+		ezopt.pathout = outdir;
+		ezopt.notify  = bench_event;
+		ezopt.ev_mask = EN_EVENT_BIT(EN_PROC_STATS) |
+				EN_EVENT_BIT(EN_FRAME_EFFECT);
+		bench_res     = res;
+
+		res->rc = ezthumb(path, &ezopt);
+		if (write(fd[1], res, sizeof(struct ezbres)) < 0) {
+			_exit(1);
+		}
+		_exit(0);
+	}
+
+	close(fd[1]);
+	if (read(fd[0], res, sizeof(struct ezbres)) !=
+			sizeof(struct ezbres)) {
+		res->rc = EZ_ERR_EOP;	/* the child crashed */
+	}
+	close(fd[0]);
+	if (wait4(pid, &status, 0, &usage) == pid) {
+		*rss = usage.ru_maxrss;
+	}
+	return res->rc;
+}
+
+static int bench_event(void *vobj, int event, long param, long opt, void *block)
+{
+	EZVID	*vidx = block;
+	EZFRM	*ezfrm;
+
+	(void) vobj; (void) opt;	/* stop the gcc warning */
+	if (event == EN_FRAME_EFFECT) {
+		/* record the PTS of the frame taken as the shot */
+		ezfrm = ((struct ezntf *) block)->varg2;
+		if ((param >= 0) && (param < EZB_SHOTS)) {
+			bench_res->pts[param] = ezfrm->rf_pts;
+		}
+		if (bench_res->shots <= param) {
+			bench_res->shots = (int) param + 1;
+		}
+	} else if (event == EN_PROC_STATS) {
+		bench_res->stat.bytes   += vidx->stat.bytes;
+		bench_res->stat.packets += vidx->stat.packets;
+		bench_res->stat.decoded += vidx->stat.decoded;
+		bench_res->stat.frames  += vidx->stat.frames;
+		bench_res->stat.shots   += vidx->stat.shots;
+		bench_res->stat.t_scale += vidx->stat.t_scale;
+		bench_res->stat.psnr    += vidx->stat.psnr;
+		bench_res->stat.psnr_num += vidx->stat.psnr_num;
+	}
+	return event;	/* keep it quiet */
+}
+
@@ -515,6 +515,7 @@ static int ezgui_create_window(EZGUI *gui)
 
 	/* bind the notification function to GUI mode */
 	gui->sysopt->notify = ezgui_notificate;
+	ezopt_event_interest(gui->sysopt, EN_EVENT_BIT(EN_OPEN_GOING));
 
 	ezgui_page_setup_reset(gui);
 	ezgui_setup_button_event_ok(gui->butt_setup_apply);
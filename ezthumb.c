@@ -67,6 +67,24 @@
 #ifdef	HAVE_LIBAVUTIL_IMGUTILS_H
 #include <libavutil/imgutils.h>
 #endif
+#ifdef	HAVE_AV_CPU_COUNT
+#include <libavutil/cpu.h>
+#endif
+#ifdef	HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#ifdef	HAVE_LIBAVUTIL_TIME_H
+#include <libavutil/time.h>	/* av_gettime() */
+#endif
+#include <math.h>	/* log10() for the PSNR */
+/* the png.h must be included before the setjmp.h in libpng 1.2 */
+#ifdef	HAVE_PNG_H
+#include <png.h>
+#endif
+#ifdef	HAVE_JPEGLIB_H
+#include <jpeglib.h>
+#endif
+#include <setjmp.h>
 
 /* re-use the debug convention in libcsoup */
 //#define CSOUP_DEBUG_LOCAL     SLOG_CWORD(EZTHUMB_MOD_CORE, SLOG_LVL_WARNING)
@@ -85,18 +103,231 @@
 #define	CODECP		codec
 #endif
 
+/* 20181018 the frames from avcodec_receive_frame() are reference counted
+ * so the recent good frame can be a reference instead of a copy */
+#if	defined(HAVE_AV_FRAME_REF) && defined(HAVE_AVCODEC_RECEIVE_FRAME)
+#define EZ_FRAME_REFCOUNT
+#endif
+
+/* 20181018 the scaling, composing and encoding of the shots run in the 
+ * compose stage on a separate thread, which takes the references of the
+ * decoded frames from a bounded queue. The decoding thread blocks while 
+ * the queue is full so no more than EZ_PIPE_DEPTH frames are held */
+#if	defined(HAVE_PTHREAD_H) && defined(EZ_FRAME_REFCOUNT)
+#define EZ_PIPELINE
+#define EZ_PIPE_DEPTH	4
+
+typedef	struct	{
+	AVFrame		*frame;		/* reference of the decoded frame */
+	int		idx;		/* the index of the shot */
+	char		timestamp[64];
+} EZSHOT;
+
+typedef	struct	{
+	pthread_t	tid;
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;		/* the queue or the stage changed */
+	EZSHOT		shot[EZ_PIPE_DEPTH];
+	int		head;		/* the first shot in the queue */
+	int		num;		/* shots in the queue */
+	int		busy;		/* a shot is being composed */
+	int		quit;
+	EZVID		*vidx;
+	EZIMG		*image;
+} EZPIPE;
+
+/* 20181018 the seekers are the private demuxers and decoders of the same
+ * file. Each seeker takes the shots by the interleaved index so it only
+ * seeks forward. The shots were composed in order by the main thread */
+#define EZ_SEEK_WAIT	0
+#define EZ_SEEK_DONE	1
+#define EZ_SEEK_FAIL	-1
+
+typedef	struct	{
+	AVFrame		*frame;		/* reference of the decoded frame */
+	int64_t		rf_pts;
+	int64_t		rf_dts;
+	int		state;		/* EZ_SEEK_WAIT/DONE/FAIL */
+} EZSLOT;
+
+typedef	struct	{
+	EZVID		vid;		/* private demuxer and decoder */
+	EZOPT		opt;		/* private copy with events muted */
+	pthread_t	tid;
+	int		id;
+	void		*para;		/* link to the EZPARA */
+} EZSEEKER;
+
+typedef	struct	{
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;		/* a slot or the cursor changed */
+	EZSLOT		*slot;		/* one slot for each shot */
+	int		cursor;		/* the next shot to be composed */
+	int		window;		/* maximum shots ahead of the cursor */
+	int		quit;
+	EZVID		*vidx;
+	EZIMG		*image;
+	EZSEEKER	*seeker;
+	int		snum;		/* number of seekers */
+} EZPARA;
+#endif
+
+/* 20181018 the I/O backend of the local files. The default file protocol
+ * reads everything by the same small buffer. The backend reads the file 
+ * by a large read ahead block in the sequential pattern, or from the 
+ * memory map by request, which saves the system calls and the copy
+ * from the kernel. The access pattern also goes to the kernel as the advice */
+#if	defined(CFG_UNIX_API) && defined(HAVE_AVFORMAT_OPEN_INPUT)
+#define EZ_IO_BACKEND
+#include <fcntl.h>
+#ifdef	HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+typedef	struct	{
+	AVIOContext	*avio;
+	int		fd;
+	int		mode;		/* EZ_IO_BUFFER or EZ_IO_MMAP */
+	int		pattern;	/* EZ_IO_SEQUENTIAL or EZ_IO_RANDOM */
+	int64_t		size;		/* size of the file, or of the map */
+	int64_t		pos;		/* the current position */
+	unsigned char	*map;		/* the memory mapped file */
+	unsigned char	*rabuf;		/* the read ahead block */
+	int64_t		rapos;		/* file position of the block */
+	int		ralen;		/* valid bytes in the block */
+	int64_t		bytes;		/* bytes read */
+	unsigned long	seeks;		/* position changed */
+} EZIO;
+#endif
+
+/* 20181018 the streaming encoder of the banded canvas. The finished bands
+ * are encoded row by row so the whole canvas is never in memory */
+#if	defined(HAVE_JPEGLIB_H) || defined(HAVE_PNG_H)
+#define EZ_BANDED
+
+typedef	struct	{
+	FILE		*fout;
+	unsigned char	*line;		/* RGB row for the encoder */
+	jmp_buf		jmpbuf;		/* return from the encoder errors */
+	int		format;		/* EZ_IMG_FMT_JPEG or EZ_IMG_FMT_PNG */
+#ifdef	HAVE_JPEGLIB_H
+	struct	jpeg_compress_struct	jcom;
+	struct	jpeg_error_mgr		jerr;
+#endif
+#ifdef	HAVE_PNG_H
+	png_structp	png;
+	png_infop	info;
+#endif
+} EZBAND;
+#endif
+
+/* 20181018 the frame encoder of the GIF89 animation. The shots are 
+ * quantized by the median cut on the subsampled RGB15 histogram, which is
+ * refined by one pass of the k-means. Only the rectangle changed from the
+ * previous frame is encoded, where the unchanged pixels are transparent.
+ * The global palette is made of the first EZ_GIFX_SAMPLES shots */
+#ifdef	HAVE_GDIMAGEGIFANIMBEGIN
+#define EZ_GIFX_SAMPLES	4
+#define EZ_GIFX_COLORS	255		/* the last index is transparent */
+#define EZ_GIFX_RGB15(r,g,b)	((((r) >> 3) << 10) | (((g) >> 3) << 5) | \
+					((b) >> 3))
+#define EZ_GIFX_AXIS(k,a)	(((k) >> (10 - (a) * 5)) & 31)
+#define EZ_GIFX_RGB8(k,a)	((EZ_GIFX_AXIS(k,a) << 3) | 4)
+
+typedef	struct	{
+	int		from;		/* the first bin of the box */
+	int		num;		/* number of bins in the box */
+	int		weight;		/* population of the box */
+	int		axis;		/* the longest axis: 0=R, 1=G, 2=B */
+	int		low;		/* the lowest value in the axis */
+	int		span;		/* the length of the axis */
+} EZGIFBOX;
+
+typedef	struct	{
+	FILE		*fout;
+	int		global;		/* using the global palette */
+	int		frames;		/* frames written */
+	int		samples;	/* shots buffered for the palette */
+	gdImage		*sample[EZ_GIFX_SAMPLES];
+	int		*screen;	/* RGB of the displayed animation */
+	unsigned char	*index;		/* the quantized frame */
+	int		colors;		/* colors in the palette */
+	int		red[256];
+	int		green[256];
+	int		blue[256];
+	short		lookup[32768];	/* RGB15 to the color (-1=unknown) */
+	int		hist[32768];	/* RGB15 histogram */
+	int		bins[32768];	/* the non-empty bins of histogram */
+	EZGIFBOX	box[EZ_GIFX_COLORS];
+} EZGIFX;
+#endif
+
+/* 20181018 the glyph atlas of the timestamp. The coverage maps of the 
+ * characters in the timestamp are rendered by FreeType once in a run and
+ * blended into the shots in the inset color later. The atlases are kept 
+ * in EZOPT, one for each font size, and read only after created so they
+ * can be shared by threads, unlike the FreeType cache of the GD library */
+#define EZ_GLYPH_SET	"0123456789:,()"
+
+typedef	struct	{
+	int		left;		/* ink box to the pen position */
+	int		top;		/* ink box to the baseline */
+	int		width;
+	int		height;
+	int		advance;	/* distance to the next pen position */
+	unsigned char	*alpha;		/* coverage map of the ink box */
+} EZGLYPH;
+
+typedef	struct	_EzAtlas	{
+	struct	_EzAtlas	*next;	/* the atlas of another font size */
+	int		fsize;		/* the font size of the atlas */
+	EZGLYPH		glyph[sizeof(EZ_GLYPH_SET) - 1];
+	char		font[1];	/* the font of the atlas */
+} EZATLAS;
+
+/* the size of the decoded frames in the lowres level */
+#define EZ_LOWRES(n,l)	(((n) + (1 << (l)) - 1) >> (l))
+
+/* the folder of the probe cache under the user's configure directory */
+#define EZ_PROBE_PATH	"ezthumb" SMM_DEF_DELIM "probe"
+
 static int video_snapping(EZVID *vidx, EZIMG *image);
 static int video_snapshot_keyframes(EZVID *vidx, EZIMG *image);
 static int video_snapshot_skim(EZVID *vidx, EZIMG *image);
 static int video_snapshot_safemode(EZVID *vidx, EZIMG *image);
 static int video_snapshot_scan(EZVID *vidx, EZIMG *image);
 static int video_snapshot_twopass(EZVID *vidx, EZIMG *image);
+static int video_snapshot_onepass(EZVID *vidx, EZIMG *image);
+static int video_snapshot_parallel(EZVID *vidx, EZIMG *image);
+static int video_seekers(EZVID *vidx, EZIMG *image);
+#ifdef	EZ_PIPELINE
+static int video_stat_merge(EZSTAT *dst, EZSTAT *src);
+static void *video_seeker_worker(void *arg);
+static int64_t video_seeker_shot(EZVID *vidx, int64_t dts_snap);
+static int video_seeker_mute(void *nobj, int event, long param, long, void *);
+#endif
 
 static EZVID *video_allocate(EZOPT *ezopt, char *filename, int *errcode);
 static EZVID *video_alloc_queue(EZOPT *ezopt, char **fname, int fnum);
 static int video_free(EZVID *vidx);
 static int video_open(EZVID *vidx);
 static int video_close(EZVID *vidx);
+static int video_codec_open(EZVID *vidx, int lowres);
+static int video_io_open(EZVID *vidx);
+static int video_io_close(EZVID *vidx);
+static int video_io_pattern(EZVID *vidx, int pattern);
+#ifdef	EZ_IO_BACKEND
+static int video_io_read(void *opaque, uint8_t *buf, int size);
+static int64_t video_io_seek(void *opaque, int64_t offset, int whence);
+#endif
+static int video_lowres(EZVID *vidx, EZIMG *image);
+static int video_rewind(EZVID *vidx);
+static int video_threading(EZVID *vidx);
+static int video_scaler(EZVID *vidx, EZIMG *image, int width, int height);
+static int video_scaler_bench(EZVID *vidx, AVFrame *frame, int idx, int us);
+static int video_probe_load(EZVID *vidx);
+static int video_probe_save(EZVID *vidx);
+static char *video_probe_key(EZVID *vidx, char *fname, char *stamp);
 static int video_connect(EZVID *vidx, EZIMG *image);
 static int video_disconnect(EZVID *vidx);
 static int video_find_main_stream(EZVID *vidx);
@@ -104,18 +335,38 @@ static int64_t video_keyframe_next(EZVID *vidx, AVPacket *packet);
 static int64_t video_keyframe_to(EZVID *vidx, AVPacket *packet, int64_t pos);
 static int video_keyframe_credit(EZVID *vidx, int64_t dts);
 static int video_dts_ruler(EZVID *vidx, int64_t cdts, int64_t ndts);
+static int video_keyidx_add(EZVID *vidx, int64_t dts, int64_t pos);
+static EZKEY *video_keyidx_find(EZVID *vidx, int64_t dts);
+static int video_keyidx_seek(EZVID *vidx, EZKEY *key);
+static int64_t video_keyidx_jump(EZVID *vidx, int64_t dts, int64_t from);
+static int video_index_load(EZVID *vidx);
 static int64_t video_load_packet(EZVID *vidx, AVPacket *packet);
 static void video_free_packet(AVPacket *packet);
 static int video_media_on_canvas(EZVID *vidx, EZIMG *image);
 static EZTIME video_duration(EZVID *vidx);
 static EZTIME video_duration_quickscan(EZVID *vidx);
 static EZTIME video_duration_fullscan(EZVID *vidx);
+static EZTIME video_duration_tailscan(EZVID *vidx);
+static int64_t video_tail_last_pts(EZVID *vidx, unsigned char *buf, int len);
+static int64_t video_tail_pes_pts(unsigned char *pes, int len);
+static int video_seek_policy(EZVID *vidx);
 static int video_seek_challenge(EZVID *vidx);
 static int64_t video_statistics(EZVID *vidx);
 static int64_t video_snap_point(EZVID *vidx, EZIMG *image, int index);
 static int video_snap_begin(EZVID *vidx, EZIMG *image, int method);
 static int video_snap_update(EZVID *vidx, EZIMG *image, int64_t dts);
+static int video_snap_frame(EZVID *vidx, EZIMG *image, EZFRM *ezfrm, 
+		int64_t dts);
 static int video_snap_end(EZVID *vidx, EZIMG *image);
+static int video_snap_compose(EZVID *vidx, EZIMG *image, AVFrame *frame,
+		int idx, char *timestamp);
+static int video_pipe_open(EZVID *vidx, EZIMG *image);
+static int video_pipe_push(EZVID *vidx, AVFrame *frame, int idx, char *ts);
+static int video_pipe_flush(EZVID *vidx);
+static int video_pipe_close(EZVID *vidx);
+#ifdef	EZ_PIPELINE
+static void *video_pipe_worker(void *arg);
+#endif
 static EZFRM *video_frame_alloc(int pixfmt, int width, int height);
 static int video_frame_free(EZFRM **ezfrm);
 static int video_frame_reset(EZVID *vidx);
@@ -130,7 +381,11 @@ static int video_frame_save_raw(EZVID *vidx, EZFRM *ezfrm);
 #ifdef	CFG_SNAPSHOT_RGB
 static int video_frame_save_rgb(EZVID *vidx, EZFRM *ezfrm);
 #endif
+static int video_decode_packet(EZVID *vidx, AVPacket *packet);
+static int video_decode_skip(EZVID *vidx, int skip);
+static int64_t video_skip_point(EZVID *vidx, int64_t dtsto);
 static int64_t video_decode_next(EZVID *vidx, AVPacket *);
+static int64_t video_decode_ring(EZVID *vidx, EZRING *ring, int64_t dtsto);
 static int64_t video_decode_to(EZVID *vidx, AVPacket *packet, int64_t dtsto);
 static int64_t video_decode_valided(EZVID *vidx, AVPacket *packet, int64_t);
 static int64_t video_decode_load(EZVID *vidx, AVPacket *packet, int64_t dtsto);
@@ -154,13 +409,24 @@ static int image_user_profile(EZIMG *image, int src_width, int *col, int *row,
 		int *width, int *height, int *facto);
 static int image_font_test(EZIMG *image, char *filename);
 static int image_gdframe_update(EZIMG *image, AVFrame *frame);
-static int image_gdframe_timestamp(EZIMG *image, char *timestamp);
+static int image_gdframe_timestamp(EZIMG *image, gdImage *dst, 
+		int ox, int oy, char *timestamp);
 static int image_gdframe_save(EZIMG *image, char *filename, int idx);
 static int image_gdframe_strlen(EZIMG *image, int fsize, char *s);
-static int image_gdframe_puts(EZIMG *image, int fsize, int x, int y, 
+static int image_gdframe_puts(EZIMG *image, gdImage *dst, int fsize, 
+		int x, int y, int c, char *s);
+static EZATLAS *image_atlas_create(char *font, int fsize);
+static int image_atlas_free(EZATLAS *atlas);
+static EZATLAS *image_atlas_find(EZIMG *image);
+static int image_atlas_render(char *font, EZGLYPH *glyph, int fsize, 
+		int ch);
+static int image_atlas_measure(EZATLAS *atlas, char *s, int *box);
+static int image_atlas_puts(EZIMG *image, gdImage *dst, int x, int y, 
 		int c, char *s);
 static int image_gdcanvas_save(EZIMG *image, char *filename);
-static int image_gdcanvas_update(EZIMG *image, int idx);
+static int image_gd_output(EZIMG *image, gdImage *img, FILE *fout);
+static int image_gdcanvas_update(EZIMG *image, AVFrame *frame, int idx,
+		char *timestamp);
 static int image_gdcanvas_print(EZIMG *image, int row, int off, char *s);
 static int image_gdcanvas_strlen(EZIMG *image, int fsize, char *s);
 static int image_gdcanvas_puts(EZIMG *image, int fsize, int x, int y, 
@@ -170,6 +436,14 @@ static int image_gdcanvas_background(EZIMG *image);
 static FILE *image_gif_anim_open(EZIMG *image, char *filename);
 static int image_gif_anim_add(EZIMG *image, FILE *fout, int interval);
 static int image_gif_anim_close(EZIMG *image, FILE *fout);
+static int image_gif_anim_begin(EZGIFX *gifx, int width, int height);
+static int image_gif_histogram(EZGIFX *gifx, gdImage *src);
+static int image_gif_palette(EZGIFX *gifx);
+static int image_gif_box_measure(EZGIFX *gifx, EZGIFBOX *box);
+static int image_gif_nearest(EZGIFX *gifx, int r, int g, int b);
+static int image_gif_frame(EZIMG *image, EZGIFX *gifx, gdImage *src, 
+		int interval);
+static int image_gif_flush(EZIMG *image, EZGIFX *gifx, int interval);
 #endif
 static FILE *image_create_file(EZIMG *image, char *filename, int idx);
 static int image_cal_ratio(int ratio, int refsize);
@@ -180,6 +454,23 @@ static int image_cal_gif_animix(EZOPT *ezopt);
 static gdFont *image_fontset(int fsize);
 static int image_fontsize(int fsize, int refsize);
 static int image_copy(gdImage *dst, gdImage *src, int x, int, int, int);
+static gdImage *image_band_create(EZIMG *image);
+static int image_band_free(EZIMG *image);
+static int image_band_top(EZIMG *image, int grid);
+static int image_band_map(EZIMG *image, int grid);
+static int image_band_seek(EZIMG *image, int grid);
+static int image_band_open(EZIMG *image, char *filename);
+static int image_band_write(EZIMG *image);
+static int image_band_close(EZIMG *image);
+#ifdef	EZ_BANDED
+static int image_band_abort(EZIMG *image);
+#endif
+#ifdef	HAVE_JPEGLIB_H
+static void image_band_jpeg_error(j_common_ptr cinfo);
+#endif
+#ifdef	HAVE_PNG_H
+static void image_band_png_error(png_structp png, png_const_charp msg);
+#endif
 
 static int ezopt_thumb_name(EZOPT *ezopt, char *buf, char *fname, int idx);
 static char *ezopt_name_build(char *path, char *fname, char *buf, char *sfx);
@@ -187,6 +478,7 @@ static char *ezopt_name_build(char *path, char *fname, char *buf, char *sfx);
 static int ezdefault(EZOPT *ezopt, int event, long param, long opt, void *);
 static int dump_media_brief(EZVID *vidx);
 static int dump_media_statistic(struct MeStat *mestat, int n, EZVID *vidx);
+static int dump_video_stats(EZVID *vidx, char *fname);
 static int dump_format_context(AVFormatContext *format);
 static int dump_stream_common(AVStream *stream, int sidx);
 static int dump_video_context(AVStream *stream);
@@ -212,6 +504,9 @@ void ezopt_init(EZOPT *ezopt, char *profile)
 	 * last frame, no shadows */
 	ezopt->flags = EZOP_INFO | EZOP_TIMEST | EZOP_DECODE_OTF | 
 			EZOP_THUMB_COPY | EZOP_DUR_HEAD;
+	/* 20181018 the Lanczos scaler is the default until the auto mode
+	 * was backed by the measurements of 'make bench' */
+	EZOP_SCALE_SET(ezopt->flags, EZOP_SCALE_BEST);
 
 	//ezopt->grid_gap_w = 4 | EZ_RATIO_OFF;
 	//ezopt->grid_gap_h = 4 | EZ_RATIO_OFF;
@@ -249,6 +544,10 @@ void ezopt_init(EZOPT *ezopt, char *profile)
 	ezopt->vs_user = -1;	/* default: first found video stream */
 	ezopt->r_flags = SMM_PATH_DIR_FIFO;
 	ezopt->accept  = csc_extname_filter_open(EZ_DEF_FILTER);
+	ezopt->jobs = 1;	/* one file at a time */
+	ezopt->seekers = 1;	/* one demuxer in a file */
+	ezopt->ev_mask = EN_EVENT_ALL;
+	ezopt->ev_rate = EN_PROGRESS_RATE;
 
 	if (profile) {
 		ezopt_profile_setup(ezopt, profile);
@@ -418,6 +717,67 @@ int ezopt_load_config(EZOPT *ezopt, void *config)
 				lookup_idnum_string(id_mprocess, 
 					EZOP_PROC_AUTO, s));
 	}
+	s = csc_cfg_read(config, NULL, CFG_KEY_DEC_THREADING);
+	if (s != NULL) {
+		EZOP_THREAD_SET(ezopt->flags,
+				lookup_idnum_string(id_threading,
+					EZOP_THREAD_AUTO, s));
+	}
+	csc_cfg_read_int(config, NULL, CFG_KEY_DEC_THREADS,
+			&ezopt->dec_threads);
+	csc_cfg_read_int(config, NULL, CFG_KEY_SEEKERS, &ezopt->seekers);
+	s = csc_cfg_read(config, NULL, CFG_KEY_SCALE_QUALITY);
+	if (s != NULL) {
+		EZOP_SCALE_SET(ezopt->flags,
+				lookup_idnum_string(id_scaling,
+					EZOP_SCALE_BEST, s));
+	}
+	s = csc_cfg_read(config, NULL, CFG_KEY_PROBE_CACHE);
+	if (s != NULL) {
+		if (!strcasecmp(s, "yes")) {
+			ezopt->flags |= EZOP_PROBE_CACHE;
+		} else {
+			ezopt->flags &= ~EZOP_PROBE_CACHE;
+		}
+	}
+	s = csc_cfg_read(config, NULL, CFG_KEY_LOWRES);
+	if (s != NULL) {
+		if (!strcasecmp(s, "yes")) {
+			ezopt->flags |= EZOP_LOWRES;
+		} else {
+			ezopt->flags &= ~EZOP_LOWRES;
+		}
+	}
+	s = csc_cfg_read(config, NULL, CFG_KEY_BANDED);
+	if (s != NULL) {
+		if (!strcasecmp(s, "yes")) {
+			ezopt->flags |= EZOP_BANDED;
+		} else {
+			ezopt->flags &= ~EZOP_BANDED;
+		}
+	}
+	csc_cfg_read_int(config, NULL, CFG_KEY_PROGRESS_RATE, 
+			&ezopt->ev_rate);
+	s = csc_cfg_read(config, NULL, CFG_KEY_GIF_PALETTE);
+	if (s != NULL) {
+		if (!strcasecmp(s, "global")) {
+			ezopt->gif_palette = EZ_GIFPAL_GLOBAL;
+		} else {
+			ezopt->gif_palette = EZ_GIFPAL_LOCAL;
+		}
+	}
+	s = csc_cfg_read(config, NULL, CFG_KEY_IO_MODE);
+	if (s != NULL) {
+		if (!strcasecmp(s, "ffmpeg")) {
+			ezopt->io_mode = EZ_IO_FFMPEG;
+		} else if (!strcasecmp(s, "buffer")) {
+			ezopt->io_mode = EZ_IO_BUFFER;
+		} else if (!strcasecmp(s, "mmap")) {
+			ezopt->io_mode = EZ_IO_MMAP;
+		} else {
+			ezopt->io_mode = EZ_IO_AUTO;
+		}
+	}
 	return 0;
 }
 
@@ -534,6 +894,33 @@ int ezopt_store_config(EZOPT *ezopt, void *config)
 	if (s != NULL) {
 		csc_cfg_write(config, NULL, CFG_KEY_MEDIA_PROC, s);
 	}
+	s = lookup_string_idnum(id_threading, -1, 
+			EZOP_THREAD_GET(ezopt->flags));
+	if (s != NULL) {
+		csc_cfg_write(config, NULL, CFG_KEY_DEC_THREADING, s);
+	}
+	csc_cfg_write_int(config, NULL, CFG_KEY_DEC_THREADS,
+			ezopt->dec_threads);
+	csc_cfg_write_int(config, NULL, CFG_KEY_SEEKERS, ezopt->seekers);
+	s = lookup_string_idnum(id_scaling, -1, EZOP_SCALE_GET(ezopt->flags));
+	if (s != NULL) {
+		csc_cfg_write(config, NULL, CFG_KEY_SCALE_QUALITY, s);
+	}
+	csc_cfg_write(config, NULL, CFG_KEY_PROBE_CACHE, 
+			ezopt->flags & EZOP_PROBE_CACHE ? "Yes" : "No");
+	csc_cfg_write(config, NULL, CFG_KEY_LOWRES, 
+			ezopt->flags & EZOP_LOWRES ? "Yes" : "No");
+	csc_cfg_write(config, NULL, CFG_KEY_BANDED, 
+			ezopt->flags & EZOP_BANDED ? "Yes" : "No");
+	csc_cfg_write(config, NULL, CFG_KEY_GIF_PALETTE, 
+			ezopt->gif_palette == EZ_GIFPAL_GLOBAL ? 
+			"Global" : "Local");
+	csc_cfg_write(config, NULL, CFG_KEY_IO_MODE, 
+			ezopt->io_mode == EZ_IO_FFMPEG ? "FFmpeg" :
+			ezopt->io_mode == EZ_IO_BUFFER ? "Buffer" :
+			ezopt->io_mode == EZ_IO_MMAP ? "Mmap" : "Auto");
+	csc_cfg_write_int(config, NULL, CFG_KEY_PROGRESS_RATE, 
+			ezopt->ev_rate);
 	return 0;
 }
 
@@ -606,7 +993,7 @@ int ezthumb(char *filename, EZOPT *ezopt)
 	int	rc;
 
 	if (ezopt_thumb_name(ezopt, NULL, filename, -1) == EZ_THUMB_SKIP) {
-		eznotify(NULL, EN_SKIP_EXIST, 0, 0, filename);
+		eznotify(ezopt, EN_SKIP_EXIST, 0, 0, filename);
 		return EZ_ERR_EOP;
 	}
 	//dump_filename("OPEN", filename);
@@ -618,7 +1005,12 @@ int ezthumb(char *filename, EZOPT *ezopt)
 		return rc;
 	}
 
-	video_open(vidx);
+	/* 20181014 the media was kept open by video_allocate() */
+	if ((rc = video_rewind(vidx)) != EZ_ERR_NONE) {
+		image_free(image);
+		video_free(vidx);
+		return rc;
+	}
 	if ((rc = video_connect(vidx, image)) != EZ_ERR_NONE) {
 		image_free(image);
 		video_free(vidx);
@@ -667,7 +1059,7 @@ int ezthumb_bind(char **fname, int fnum, EZOPT *ezopt)
 
 	if (ezopt_thumb_name(ezopt, NULL, vanchor->filename, -1) == 
 			EZ_THUMB_SKIP) {
-		eznotify(NULL, EN_SKIP_EXIST, 0, 0, vanchor->filename);
+		eznotify(ezopt, EN_SKIP_EXIST, 0, 0, vanchor->filename);
 		video_free(vanchor);
 		return EZ_ERR_EOP;
 	}
@@ -754,7 +1146,39 @@ int eznotify(EZOPT *ezopt, int event, long param, long opt, void *block)
 {
 	int	rc;
 
-	if ((ezopt == NULL) || (ezopt->notify == NULL)) {
+	if (ezopt == NULL) {
+		return ezdefault(ezopt, event, param, opt, block);
+	}
+
+	/* 20181018 skip the events that nobody is interested in */
+	if (!EN_EVENT_WANT(ezopt, event)) {
+		return event;
+	}
+
+	/* 20181018 coalesce the progress events by the rate. The first
+	 * and the last progress are always dispatched */
+	switch (event) {
+	case EN_PROC_BEGIN:
+	case EN_OPEN_BEGIN:
+		smm_time_get_epoch(&ezopt->ev_tmark);
+		break;
+	case EN_PROC_CURRENT:
+		if ((param == 0) || (opt <= 1) || (opt >= param)) {
+			break;	/* key frames, the first and the last */
+		}
+		/* falling through */
+	case EN_OPEN_GOING:
+		if (ezopt->ev_rate <= 0) {
+			break;
+		}
+		if (smm_time_diff(&ezopt->ev_tmark) < ezopt->ev_rate) {
+			return event;
+		}
+		smm_time_get_epoch(&ezopt->ev_tmark);
+		break;
+	}
+
+	if (ezopt->notify == NULL) {
 		return ezdefault(ezopt, event, param, opt, block);
 	}
 
@@ -765,6 +1189,21 @@ int eznotify(EZOPT *ezopt, int event, long param, long opt, void *block)
 	return rc;
 }
 
+/* 20181018 register the events which the notify function is interested in.
+ * The events needed by the default handler are added by the debug level,
+ * so this should be called after the debug level was set. The hot events
+ * of every packet and frame are dropped if nobody wants them */
+unsigned long long ezopt_event_interest(EZOPT *ezopt, 
+		unsigned long long interest)
+{
+	ezopt->ev_mask = interest | (EN_EVENT_ALL & ~EN_EVENT_HOT);
+	if (EZOP_DEBUG(ezopt->flags) >= SLOG_LVL_PROGRAM) {
+		/* ezdefault() dumps the frames */
+		ezopt->ev_mask |= EN_EVENT_BIT(EN_FRAME_DONE);
+	}
+	return ezopt->ev_mask;
+}
+
 /****************************************************************************
  * Internal Functions
  ***************************************************************************/
@@ -781,10 +1220,13 @@ static int video_snapping(EZVID *vidx, EZIMG *image)
 		vidx->keydelta = 0;
 	}
 	video_keyframe_credit(vidx, -1);
+	video_pipe_open(vidx, image);
+	/* the skim mode would turn it to the random pattern */
+	video_io_pattern(vidx, EZ_IO_SEQUENTIAL);
 
 	switch (EZOP_PROC(vidx->ses_flags)) {
 	case EZOP_PROC_SKIM:
-		rc = video_snapshot_skim(vidx, image);
+		rc = video_snapshot_parallel(vidx, image);
 		break;
 	case EZOP_PROC_SCAN:
 		rc = video_snapshot_scan(vidx, image);
@@ -795,17 +1237,21 @@ static int video_snapping(EZVID *vidx, EZIMG *image)
 	case EZOP_PROC_TWOPASS:
 		rc = video_snapshot_twopass(vidx, image);
 		break;
+	case EZOP_PROC_ONEPASS:
+		rc = video_snapshot_onepass(vidx, image);
+		break;
 	case EZOP_PROC_KEYRIP:
 		rc = video_snapshot_keyframes(vidx, image);
 		break;
 	default:
 		if (SEEKABLE(vidx->seekable)) {
-			rc = video_snapshot_skim(vidx, image);
+			rc = video_snapshot_parallel(vidx, image);
 		} else {
 			rc = video_snapshot_scan(vidx, image);
 		}
 		break;
 	}
+	video_pipe_close(vidx);
 	return rc;
 }
 
@@ -874,6 +1320,7 @@ static int video_snapshot_skim(EZVID *vidx, EZIMG *image)
 	int		scnt = 0, disable_seeking = 0;
 
 	video_snap_begin(vidx, image, ENX_SS_SKIM);
+	video_io_pattern(vidx, EZ_IO_RANDOM);
 	/* setup the first key frame as a reference start point */
 	last_key = dts = vidx->dts_offset;
 	while (image->taken < image->shots) {
@@ -900,7 +1347,10 @@ static int video_snapshot_skim(EZVID *vidx, EZIMG *image)
 		 * ahead then decode to the target position. 
 		 * slower but functional */
 		dts = dts_snap;
-		if (GETACCUR(vidx->ses_flags)) {
+		if (GETACCUR(vidx->ses_flags) && 
+				!video_keyidx_find(vidx, dts_snap)) {
+			/* 20181016 no need to step back if the key frame
+			 * index exists. It seeks to the exact key frame */
 			if ((dts -= vidx->keygap * 2) < 0) {
 				dts = 0;
 			}
@@ -965,7 +1415,7 @@ vs_skim_update:
 static int video_snapshot_scan(EZVID *vidx, EZIMG *image)
 {
 	AVPacket	packet;
-	int64_t		dts, dts_snap;
+	int64_t		dts, dts_snap, dts_cur;
 	int		scnt = 0;
 
 	video_snap_begin(vidx, image, ENX_SS_SCAN);
@@ -985,12 +1435,16 @@ static int video_snapshot_scan(EZVID *vidx, EZIMG *image)
 			goto vs_scan_update;
 		}
 
+		dts_cur = dts;
 		dts = dts_snap;
 		if (GETACCUR(vidx->ses_flags)) {
 			if ((dts -= vidx->keygap) < 0) {
 				dts = 0;
 			}
 		}
+		/* 20181016 jump to the key frame just before the target by 
+		 * the key frame index instead of reading through packets */
+		video_keyidx_jump(vidx, dts, dts_cur);
 		dts = video_keyframe_to(vidx, &packet, dts);
 
 		if (dts < 0) {
@@ -1045,6 +1499,7 @@ vs_scan_update:
 static int video_snapshot_twopass(EZVID *vidx, EZIMG *image)
 {
 	AVPacket	packet;
+	EZKEY		*ki;
 	int64_t		*refdts;
 	int64_t		dts, dts_snap, lastkey;
 	int		i, sflag, scnt = 0;
@@ -1060,6 +1515,22 @@ static int video_snapshot_twopass(EZVID *vidx, EZIMG *image)
 
 	video_snap_begin(vidx, image, ENX_SS_TWOPASS);
 
+	/* 20181016 the key frame index could replace the first pass if it
+	 * covered the video from the beginning */
+	if (video_keyidx_find(vidx, lastkey) != NULL) {
+		video_free_packet(&packet);
+		dts = lastkey;
+		for (i = image->taken; i < image->shots; i++) {
+			if ((dts_snap = video_snap_point(vidx, image, i)) < 0) {
+				break;
+			}
+			ki = video_keyidx_find(vidx, dts_snap);
+			refdts[i] = ki ? ki->dts : lastkey;
+			VSTLOG("[KI]", refdts[i], dts_snap, dts);
+		}
+		goto vs_twopass_second;
+	}
+
 	/* the first pass to locate the key frames just ahead of the 
 	 * snap points */
 	dts = lastkey;
@@ -1091,6 +1562,7 @@ static int video_snapshot_twopass(EZVID *vidx, EZIMG *image)
 		}
 	}
 
+vs_twopass_second:
 	/* check if the video clip is in lack of seperate key frames */
 	sflag = 0;
 	for (i = image->taken + 1; i < image->shots; i++) {
@@ -1108,6 +1580,9 @@ static int video_snapshot_twopass(EZVID *vidx, EZIMG *image)
 			break;
 		}
 
+		/* 20181016 jump to the reference key frame directly */
+		video_keyidx_jump(vidx, refdts[image->taken], dts);
+
 		while (dts < refdts[image->taken]) {
 			/* hasn't entered the range yet, go read more */
 			if ((dts = video_keyframe_next(vidx, &packet)) < 0) {
@@ -1157,6 +1632,101 @@ static int video_snapshot_twopass(EZVID *vidx, EZIMG *image)
 	return scnt;	/* return the number of thumbnails */
 }
 
+#define VS1LOG(s,a,b)	\
+	CDB_PROG(("video_snapshot_onepass: %s %lld/%lld\n", (s),(a),(b)))
+
+/* 20181017 The accurate mode in a single pass. It keeps the packets since 
+ * the recent key frame in a ring buffer and only starts decoding when the
+ * snap point fell into the current GOP, so it takes the same frames as the
+ * two-pass mode but reads the file only once. If the GOP were too long to
+ * be buffered, it decodes the packets on the fly until the next key frame */
+static int video_snapshot_onepass(EZVID *vidx, EZIMG *image)
+{
+	AVPacket	packet;
+	EZRING		*ring;
+	int64_t		dts, dts_snap;
+	int		scnt = 0;
+
+	if ((ring = smm_alloc(sizeof(EZRING))) == NULL) {
+		return EZ_ERR_LOWMEM;
+	}
+
+	video_snap_begin(vidx, image, ENX_SS_ONEPASS);
+	dts_snap = video_snap_point(vidx, image, image->taken);
+	while ((dts_snap >= 0) && (image->taken < image->shots)) {
+		if ((dts = video_load_packet(vidx, &packet)) < 0) {
+			break;
+		}
+		if (packet.flags == AV_PKT_FLAG_KEY) {
+			/* entering a new GOP so the packets in the ring
+			 * which were not decoded are useless now */
+			if (ring->dec < ring->num) {
+				video_frame_reset(vidx);
+			}
+			while (ring->dec < ring->num) {
+				video_free_packet(&ring->pkt[ring->dec++]);
+			}
+			ring->num = ring->dec = ring->live = 0;
+			ring->keyed = 1;
+		} else if (!ring->keyed) {
+			/* no key frame ahead so it can not be decoded */
+			video_free_packet(&packet);
+			continue;
+		}
+
+		/* the ring takes over the packet */
+		ring->pkt[ring->num++] = packet;
+		if (ring->num == EZ_RING_MAX) {
+			VS1LOG("[LG]", dts, dts_snap);
+			ring->live = 1;	/* GOP is too long */
+		}
+
+		/* the snap point is inside the current GOP */
+		while (ring->live || (dts >= dts_snap)) {
+			if (video_decode_ring(vidx, ring, dts_snap) < 0) {
+				break;	/* read more packets */
+			}
+			VS1LOG("[AR]", vidx->vidframe->rf_dts, dts_snap);
+			video_snap_update(vidx, image, dts_snap);
+			scnt++;
+			if (image->taken >= image->shots) {
+				break;
+			}
+			if ((dts_snap = video_snap_point(vidx, 
+						image, image->taken)) < 0) {
+				break;
+			}
+		}
+		/* the decoded packets are released but the rest packets of
+		 * the GOP still go to the decoder, which may be holding the 
+		 * reordered or delayed frames */
+		if (ring->dec == ring->num) {
+			ring->num = ring->dec = 0;
+		}
+	}
+
+	/* end of the stream: decode the rest packets for the closest frame */
+	if ((dts_snap >= 0) && (image->taken < image->shots) && 
+			(ring->dec < ring->num)) {
+		video_decode_ring(vidx, ring, dts_snap);
+		VS1LOG("[EF]", vidx->vidframe->rf_dts, dts_snap);
+		video_snap_update(vidx, image, dts_snap);
+		scnt++;
+	}
+	/* 20130808 keep the index counter updated for the binding mode */
+	while ((image->taken < image->shots) &&
+			(video_snap_point(vidx, image, image->taken) >= 0)) {
+		image->taken++;
+	}
+
+	while (ring->dec < ring->num) {
+		video_free_packet(&ring->pkt[ring->dec++]);
+	}
+	video_snap_end(vidx, image);
+	smm_free(ring);
+	return scnt;	/* return the number of thumbnails */
+}
+
 static int video_snapshot_safemode(EZVID *vidx, EZIMG *image)
 {
 	AVPacket	packet;
@@ -1192,6 +1762,283 @@ static int video_snapshot_safemode(EZVID *vidx, EZIMG *image)
 	return scnt;	/* return the number of thumbnails */
 }
 
+/* 20181018 The parallel skim mode opens the same file by several seekers,
+ * each of which owns the demuxer and the decoder. Because the shots in 
+ * the skim mode are independent, the seekers decode them concurrently
+ * while the main thread composes the shots in the index order. The 
+ * seekers can't run ahead of the composing more than the window so the 
+ * decoded frames in memory are bounded.
+ * It falls back to the skim mode if only one seeker is available */
+static int video_snapshot_parallel(EZVID *vidx, EZIMG *image)
+{
+#ifdef	EZ_PIPELINE
+	EZPARA	*para;
+	EZSLOT	*slot;
+	EZFRM	ezfrm;
+	int	i, snum, scnt = 0;
+
+	if ((snum = video_seekers(vidx, image)) < 2) {
+		return video_snapshot_skim(vidx, image);
+	}
+	para = smm_alloc(sizeof(EZPARA) + sizeof(EZSEEKER) * snum + 
+			sizeof(EZSLOT) * image->shots);
+	if (para == NULL) {
+		return video_snapshot_skim(vidx, image);
+	}
+	para->seeker = (EZSEEKER *) &para[1];
+	para->slot   = (EZSLOT *) &para->seeker[snum];
+	para->window = snum * 2;
+	para->vidx   = vidx;
+	para->image  = image;
+	pthread_mutex_init(&para->lock, NULL);
+	pthread_cond_init(&para->cond, NULL);
+
+	for (i = 0; i < snum; i++) {
+		para->seeker[i].id   = i;
+		para->seeker[i].para = para;
+		if (pthread_create(&para->seeker[i].tid, NULL, 
+					video_seeker_worker, &para->seeker[i])) {
+			CDB_ERROR(("video_snapshot_parallel: "
+					"failed to create the seeker %d\n", i));
+			break;
+		}
+		para->snum++;
+	}
+	if (para->snum < snum) {
+		/* the shots of the missing seekers are failed */
+		for (i = 0; i < image->shots; i++) {
+			if ((i % snum) >= para->snum) {
+				para->slot[i].state = EZ_SEEK_FAIL;
+			}
+		}
+	}
+
+	video_snap_begin(vidx, image, ENX_SS_SKIM);
+	memset(&ezfrm, 0, sizeof(ezfrm));
+	while (image->taken < image->shots) {
+		slot = &para->slot[image->taken];
+		pthread_mutex_lock(&para->lock);
+		while (slot->state == EZ_SEEK_WAIT) {
+			pthread_cond_wait(&para->cond, &para->lock);
+		}
+		pthread_mutex_unlock(&para->lock);
+
+		if ((slot->state == EZ_SEEK_DONE) && 
+				(slot->frame->width == vidx->vidframe->width) &&
+				(slot->frame->height == vidx->vidframe->height)) {
+			ezfrm.frame  = slot->frame;
+			ezfrm.rf_pts = slot->rf_pts;
+			ezfrm.rf_dts = slot->rf_dts;
+			video_snap_frame(vidx, image, &ezfrm, 
+				video_snap_point(vidx, image, image->taken));
+			scnt++;
+		} else {
+			image->taken++;
+		}
+		if (slot->frame) {
+			av_frame_free(&slot->frame);
+		}
+
+		pthread_mutex_lock(&para->lock);
+		para->cursor = image->taken;
+		pthread_cond_broadcast(&para->cond);
+		pthread_mutex_unlock(&para->lock);
+	}
+	video_snap_end(vidx, image);
+
+	pthread_mutex_lock(&para->lock);
+	para->quit = 1;
+	pthread_cond_broadcast(&para->cond);
+	pthread_mutex_unlock(&para->lock);
+	for (i = 0; i < para->snum; i++) {
+		pthread_join(para->seeker[i].tid, NULL);
+		/* add up the counters of the seekers */
+		video_stat_merge(&vidx->stat, &para->seeker[i].vid.stat);
+	}
+	for (i = 0; i < image->shots; i++) {
+		if (para->slot[i].frame) {
+			av_frame_free(&para->slot[i].frame);
+		}
+	}
+	pthread_cond_destroy(&para->cond);
+	pthread_mutex_destroy(&para->lock);
+	smm_free(para);
+	return scnt;
+#else
+	return video_snapshot_skim(vidx, image);
+#endif
+}
+
+/* decide the number of seekers. The parallel seeking only works in
+ * the seekable video and not in the binding mode */
+static int video_seekers(EZVID *vidx, EZIMG *image)
+{
+#ifdef	EZ_PIPELINE
+	int	snum;
+
+	if (!SEEKABLE(vidx->seekable) || vidx->dur_all || 
+			(image->shots < 2)) {
+		return 1;
+	}
+	snum = vidx->sysopt->seekers;
+#ifdef	HAVE_AV_CPU_COUNT
+	if (snum <= 0) {
+		snum = av_cpu_count() / (vidx->sysopt->jobs > 1 ? 
+				vidx->sysopt->jobs : 1);
+	}
+#endif
+	if (snum > image->shots) {
+		snum = image->shots;
+	}
+	return snum < 1 ? 1 : snum;
+#else
+	(void) vidx; (void) image;
+	return 1;
+#endif
+}
+
+#ifdef	EZ_PIPELINE
+/* add up the counters of a seeker to the master video */
+static int video_stat_merge(EZSTAT *dst, EZSTAT *src)
+{
+	dst->bytes   += src->bytes;
+	dst->packets += src->packets;
+	dst->decoded += src->decoded;
+	dst->frames  += src->frames;
+	dst->shots   += src->shots;
+	dst->seeks   += src->seeks;
+	dst->ioseeks += src->ioseeks;
+	dst->t_open  += src->t_open;
+	dst->t_info  += src->t_info;
+	dst->t_seek  += src->t_seek;
+	return 0;
+}
+
+static void *video_seeker_worker(void *arg)
+{
+	EZSEEKER *sker = arg;
+	EZPARA	*para = sker->para;
+	EZVID	*vidx = &sker->vid;
+	EZSLOT	*slot;
+	EZFRM	*ezfrm;
+	int64_t	dts, dts_snap;
+	int	i, rc;
+
+	/* clone the video object but leave the runtime objects alone. 
+	 * The key frame index is shared as read only */
+	memcpy(vidx, para->vidx, sizeof(EZVID));
+	vidx->formatx  = NULL;
+	vidx->vstream  = NULL;
+	vidx->codecx   = NULL;
+	vidx->ioctx    = NULL;
+	vidx->swsframe = vidx->picframe = vidx->vidframe = NULL;
+#if	defined(CFG_SNAPSHOT_DUMP) || defined(CFG_SNAPSHOT_RGB)
+	vidx->capframe = NULL;
+#endif
+#ifdef	CFG_SNAPSHOT_DUMP
+	vidx->capgdimg = NULL;
+#endif
+	vidx->refframe = NULL;
+	vidx->pipeline = NULL;
+	vidx->probed   = 0;
+	vidx->anchor   = vidx->next = NULL;
+	memset(&vidx->stat, 0, sizeof(EZSTAT));
+
+	/* the events of the seekers were muted and the decoder threads 
+	 * were shared by the seekers */
+	memcpy(&sker->opt, para->vidx->sysopt, sizeof(EZOPT));
+	sker->opt.notify = video_seeker_mute;
+	sker->opt.ev_mask = 0;
+	sker->opt.jobs  *= para->snum > 1 ? para->snum : 1;
+	vidx->sysopt = &sker->opt;
+
+	rc = video_open(vidx);
+	if (rc == EZ_ERR_NONE) {
+		video_io_pattern(vidx, EZ_IO_RANDOM);
+		rc = video_connect(vidx, para->image);
+		if ((rc == EZ_ERR_NONE) && (vidx->lowres != para->vidx->lowres)) {
+			rc = EZ_ERR_CODEC_FAIL;
+		}
+	}
+	video_keyframe_credit(vidx, -1);
+
+	for (i = sker->id; i < para->image->shots; i += para->snum) {
+		slot = &para->slot[i];
+
+		/* wait for the composing to catch up */
+		pthread_mutex_lock(&para->lock);
+		while (!para->quit && (i >= para->cursor + para->window)) {
+			pthread_cond_wait(&para->cond, &para->lock);
+		}
+		pthread_mutex_unlock(&para->lock);
+		if (para->quit) {
+			break;
+		}
+
+		dts = -1;
+		if (rc == EZ_ERR_NONE) {
+			dts_snap = video_snap_point(vidx, para->image, i);
+			if (dts_snap >= 0) {
+				dts = video_seeker_shot(vidx, dts_snap);
+			}
+		}
+		ezfrm = (dts < 0) ? NULL : video_frame_best(vidx, dts_snap);
+		if (ezfrm && ezfrm->frame->buf[0] && 
+				((slot->frame = av_frame_alloc()) != NULL)) {
+			if (av_frame_ref(slot->frame, ezfrm->frame) < 0) {
+				av_frame_free(&slot->frame);
+			} else {
+				slot->rf_pts = ezfrm->rf_pts;
+				slot->rf_dts = ezfrm->rf_dts;
+			}
+		}
+		video_frame_update(vidx);
+
+		pthread_mutex_lock(&para->lock);
+		slot->state = slot->frame ? EZ_SEEK_DONE : EZ_SEEK_FAIL;
+		pthread_cond_broadcast(&para->cond);
+		pthread_mutex_unlock(&para->lock);
+	}
+
+	video_disconnect(vidx);
+	video_close(vidx);
+	return NULL;
+}
+
+/* seek and decode one shot like the skim mode. The seeker always seeks 
+ * because the next shot is at least one seeker's distance away */
+static int64_t video_seeker_shot(EZVID *vidx, int64_t dts_snap)
+{
+	AVPacket	packet;
+	int64_t		dts = dts_snap;
+
+	if (GETACCUR(vidx->ses_flags) && !video_keyidx_find(vidx, dts_snap)) {
+		if ((dts -= vidx->keygap * 2) < 0) {
+			dts = 0;
+		}
+	}
+	video_seeking(vidx, dts);
+	if ((dts = video_keyframe_next(vidx, &packet)) < 0) {
+		return dts;
+	}
+	if (dts > dts_snap) {
+		return video_decode_valided(vidx, &packet, dts_snap);
+	}
+	if (GETACCUR(vidx->ses_flags) && 
+			(video_dts_ruler(vidx, dts, dts_snap) <= 10)) {
+		return video_decode_to(vidx, &packet, dts_snap);
+	}
+	return video_decode_safe(vidx, &packet, dts_snap);
+}
+
+static int video_seeker_mute(void *nobj, int event, 
+		long param, long opt, void *block)
+{
+	(void) nobj; (void) event; (void) param; (void) opt; (void) block;
+	return 0;
+}
+#endif
+
 static EZVID *video_allocate(EZOPT *ezopt, char *filename, int *errcode)
 {
 	EZVID	*vidx;
@@ -1211,6 +2058,7 @@ static EZVID *video_allocate(EZOPT *ezopt, char *filename, int *errcode)
 	vidx->sysopt   = ezopt;
 	vidx->filename = filename;
 	vidx->seekable = ENX_SEEK_UNKNOWN;
+	vidx->stat.t_start = av_gettime();
 	vidx->filesize = smm_filesize(filename);
 	vidx->vsidx    = -1;	/* must be initialized before video_open() */
 	vidx->keygap   = -1;	/* for tracking the single i-frame videos */
@@ -1293,8 +2141,17 @@ static EZVID *video_allocate(EZOPT *ezopt, char *filename, int *errcode)
 	/* 20110301: the still images are acceptable by the ffmpeg library
 	 * so it would be wiser to avoid the still image stream, which duration
 	 * is only several milliseconds. FIXME if this assumption is wrong */
+	/* 20181015 try the probe cache before the expensive scanning */
 	if (ezopt->pre_dura == 0) {
-		video_duration(vidx);
+		if (!(ezopt->flags & EZOP_PROBE_CACHE) ||
+				(video_probe_load(vidx) != EZ_ERR_NONE)) {
+			/* 20181018 the container's own index is as good
+			 * as a scan unless the full scan was required */
+			if ((GETDURMOD(vidx->ses_flags) == EZOP_DUR_FSCAN) ||
+					(video_index_load(vidx) != EZ_ERR_NONE)) {
+				video_duration(vidx);
+			}
+		}
 	} else {
 		vidx->duration = ezopt->pre_dura;
 		vidx->seekable = ezopt->pre_seek;
@@ -1308,13 +2165,19 @@ static EZVID *video_allocate(EZOPT *ezopt, char *filename, int *errcode)
 		return NULL;
 	}
 
+	if (ezopt->flags & EZOP_PROBE_CACHE) {
+		vidx->probed = 1;
+	}
+
 	//dump_format_context(vidx->formatx);
 	eznotify(ezopt, EN_OPEN_END, 0, 0, vidx);
 	eznotify(vidx->sysopt, EN_MEDIA_OPEN, 0, 
 			smm_time_diff(&vidx->tmark), vidx);
 	uperror(errcode, EZ_ERR_NONE);
 
-	video_close(vidx);	/* do not rewinding, reopen it instead */
+	/* 20181014 keep the media open. The caller should use video_rewind()
+	 * to go back to the beginning, which is much cheaper than reopening
+	 * the media, especially on network storage */
 	return vidx;
 }
 
@@ -1332,6 +2195,7 @@ static EZVID *video_alloc_queue(EZOPT *ezopt, char **fname, int fnum)
 		if ((vidx = video_allocate(ezopt, fname[i], &rc)) == NULL) {
 			continue;
 		}
+		video_close(vidx);	/* binding mode opens them one by one */
 
 		vidx->dur_off = dur_off;
 		dur_off += vidx->duration;
@@ -1379,8 +2243,15 @@ static int video_free(EZVID *vidx)
 	EZVID	*vp;
 
 	while (vidx) {
+		/* the key frame statistics were collected all the way, 
+		 * so it's the best time to update the probe cache */
+		if (vidx->probed) {
+			video_probe_save(vidx);
+		}
 		video_disconnect(vidx);	
 		video_close(vidx);
+		eznotify(vidx->sysopt, EN_PROC_STATS, 0, 0, vidx);
+		smm_free(vidx->keyidx);
 
 		vp = vidx;
 		vidx = vidx->next;
@@ -1392,12 +2263,13 @@ static int video_free(EZVID *vidx)
 
 static int video_open(EZVID *vidx)
 {
-	AVCodec	*codec;
 	AVRational	rf_rate;
 	char	*mblock[] = { "mp3", "image2" };
+	int64_t	tmark;
 	int	i, den, num;
 
 	video_timing(vidx, EZ_PTS_CLEAR);
+	tmark = av_gettime();
 
 	/* apparently the ubuntu 10.10 still use av_open_input_file() */
 	/* FFMPEG/doc/APIchanes claim the avformat_open_input() was introduced
@@ -1405,6 +2277,8 @@ static int video_open(EZVID *vidx)
 	 * my archlinux 64-bit box by 52.110.0 */
 	/* 20120613: What a surprise that avformat_open_input() do support
 	 * utf-8 in native MSWindows */
+	/* 20181018 the local files are read by the I/O backend */
+	video_io_open(vidx);
 #ifdef	HAVE_AVFORMAT_OPEN_INPUT
 	if (avformat_open_input(&vidx->formatx, vidx->filename, 
 				NULL, NULL) != 0) {
@@ -1414,10 +2288,12 @@ static int video_open(EZVID *vidx)
 #else
 #error	No avformat_open_input() or av_open_input_file() defined!
 #endif
+		video_io_close(vidx);
 		eznotify(NULL, EZ_ERR_FORMAT, 0, 0, vidx->filename);
 		return EZ_ERR_FORMAT;
 	}
 	video_timing(vidx, EZ_PTS_MOPEN);
+	vidx->stat.t_open += av_gettime() - tmark;
 	eznotify(vidx->sysopt, EN_OPEN_GOING, 0, 0, NULL);
 
 	/* 20120814 Implemented a media type filter to block the unwanted
@@ -1434,6 +2310,7 @@ static int video_open(EZVID *vidx)
 	//vidx->formatx->flags |= AVFMT_FLAG_GENPTS;
 	//vidx->formatx->flags |= AVFMT_FLAG_IGNIDX | AVFMT_TS_DISCONT ;
 
+	tmark = av_gettime();
 #ifdef	HAVE_AVFORMAT_FIND_STREAM_INFO
 	if (avformat_find_stream_info(vidx->formatx, NULL) < 0) {
 #elif	defined(HAVE_AV_FIND_STREAM_INFO)
@@ -1445,6 +2322,7 @@ static int video_open(EZVID *vidx)
 		video_close(vidx);
 		return EZ_ERR_STREAM;
 	}
+	vidx->stat.t_info += av_gettime() - tmark;
 
 	/* 20150227 filter out the dodge video fragment because the parameter
 	   read from ffmpeg could be very harmful */
@@ -1469,30 +2347,9 @@ static int video_open(EZVID *vidx)
 	vidx->vstream->discard = AVDISCARD_ALL;
 
 	/* open the codec */
-#ifdef	HAVE_AVS_CODECPAR
-	codec = avcodec_find_decoder(vidx->vstream->codecpar->codec_id);
-	vidx->codecx = avcodec_alloc_context3(codec);
-	avcodec_parameters_to_context(vidx->codecx, vidx->vstream->codecpar);
-	av_codec_set_pkt_timebase(vidx->codecx, vidx->vstream->time_base);
-	vidx->codecx->framerate = vidx->vstream->avg_frame_rate;
-#else
-	vidx->codecx  = vidx->vstream->codec;
-	codec = avcodec_find_decoder(vidx->codecx->codec_id);
-#endif
-	/* discard frames; AVDISCARD_NONKEY,AVDISCARD_BIDIR */
-	//vidx->codecx->skip_frame = AVDISCARD_NONREF | AVDISCARD_BIDIR;
-	//vidx->codecx->hurry_up = 1; /* fast decoding mode */
-#ifdef	HAVE_AVCODEC_OPEN2
-	if (avcodec_open2(vidx->codecx, codec, NULL) < 0) {
-#elif	defined(HAVE_AVCODEC_OPEN)
-	if (avcodec_open(vidx->codecx, codec) < 0) {
-#else
-#error	None of avcodec_open2() or avcodec_open() defined!
-#endif
-		eznotify(vidx->sysopt, EZ_ERR_CODEC_FAIL, 
-				vidx->codecx->codec_id, 0, vidx->codecx);
+	if ((i = video_codec_open(vidx, 0)) != EZ_ERR_NONE) {
 		video_close(vidx);
-		return EZ_ERR_CODEC_FAIL;
+		return i;
 	}
 	vidx->vstream->discard = AVDISCARD_DEFAULT;
 
@@ -1529,6 +2386,12 @@ static int video_close(EZVID *vidx)
 		vidx->codecx = NULL;
 	}
 	if (vidx->formatx) {
+#if	LIBAVFORMAT_VERSION_INT >= (54<<16)
+		/* the I/O backend counts the bytes itself */
+		if (vidx->formatx->pb && (vidx->ioctx == NULL)) {
+			vidx->stat.bytes += vidx->formatx->pb->bytes_read;
+		}
+#endif
 #ifdef	HAVE_AVFORMAT_CLOSE_INPUT
 		avformat_close_input(&vidx->formatx);
 #elif	defined(HAVE_AV_CLOSE_INPUT_FILE)
@@ -1538,17 +2401,664 @@ static int video_close(EZVID *vidx)
 #endif
 		vidx->formatx = NULL;
 	}
+	/* the AVIOContext of the backend was not closed by the demuxer */
+	video_io_close(vidx);
 	return EZ_ERR_NONE;
 }
 
-static int video_connect(EZVID *vidx, EZIMG *image)
+/* 20181018 setup the I/O backend of the local file. It creates the 
+ * AVFormatContext with the custom AVIOContext so avformat_open_input()
+ * would use it. The URL and the special files were left to FFmpeg */
+static int video_io_open(EZVID *vidx)
 {
-	if ((vidx->picframe = video_frame_alloc(vidx->codecx->pix_fmt, 
-					vidx->width, vidx->height)) == NULL) {
-		eznotify(vidx->sysopt, EZ_ERR_VIDEOSTREAM, 
-				0, 0, vidx->filename);
+#ifdef	EZ_IO_BACKEND
+	EZIO	*eio;
+	struct	stat	fs;
+	unsigned char	*buf;
+	int	fd, mode;
+
+	mode = vidx->sysopt->io_mode;
+	if ((mode == EZ_IO_FFMPEG) || strstr(vidx->filename, "://")) {
+		return EZ_ERR_NONE;
+	}
+	if ((fd = open(vidx->filename, O_RDONLY)) < 0) {
+		return EZ_ERR_FILE;	/* let FFmpeg report it */
+	}
+	if (fstat(fd, &fs) || !S_ISREG(fs.st_mode) || (fs.st_size <= 0)) {
+		close(fd);
+		return EZ_ERR_FILE;
+	}
+	if ((eio = smm_alloc(sizeof(EZIO))) == NULL) {
+		close(fd);
 		return EZ_ERR_LOWMEM;
 	}
+	eio->fd   = fd;
+	eio->size = (int64_t) fs.st_size;
+	eio->mode = EZ_IO_BUFFER;
+#ifdef	HAVE_MMAP
+	/* the mapping is only used by request because a truncated file or
+	 * a read error raises SIGBUS, and the mapping could not follow the 
+	 * growing files. It could also fail on the huge files in 32-bit 
+	 * systems, which falls back to the buffer mode */
+	if (mode == EZ_IO_MMAP) {
+		eio->map = mmap(NULL, (size_t) eio->size, PROT_READ, 
+				MAP_SHARED, fd, 0);
+		if (eio->map == MAP_FAILED) {
+			eio->map = NULL;
+		} else {
+			eio->mode = EZ_IO_MMAP;
+		}
+	}
+#endif
+	if ((eio->mode == EZ_IO_BUFFER) && 
+			((eio->rabuf = smm_alloc(EZ_IO_READAHEAD)) == NULL)) {
+		eio->fd = -1;
+		close(fd);
+		smm_free(eio);
+		return EZ_ERR_LOWMEM;
+	}
+
+	buf = av_malloc(EZ_IO_BLOCK);
+	eio->avio = avio_alloc_context(buf, EZ_IO_BLOCK, 0, eio, 
+			video_io_read, NULL, video_io_seek);
+	vidx->formatx = avformat_alloc_context();
+	if ((buf == NULL) || (eio->avio == NULL) || (vidx->formatx == NULL)) {
+		if (eio->avio == NULL) {
+			av_free(buf);
+		}
+		vidx->ioctx = eio;
+		video_io_close(vidx);
+		return EZ_ERR_LOWMEM;
+	}
+	vidx->formatx->pb = eio->avio;
+	vidx->ioctx = eio;
+	eio->pattern = -1;	/* force to advise the kernel */
+	video_io_pattern(vidx, EZ_IO_SEQUENTIAL);
+	CDB_DEBUG(("video_io_open: %s %s\n", vidx->filename, 
+			eio->mode == EZ_IO_MMAP ? "mmap" : "buffer"));
+#else
+	(void) vidx;
+#endif
+	return EZ_ERR_NONE;
+}
+
+/* release the I/O backend after the demuxer was closed and add up its
+ * counters to the video */
+static int video_io_close(EZVID *vidx)
+{
+#ifdef	EZ_IO_BACKEND
+	EZIO	*eio = vidx->ioctx;
+
+	if (eio == NULL) {
+		return EZ_ERR_NONE;
+	}
+	vidx->ioctx = NULL;
+	if (vidx->formatx) {	/* failed before avformat_open_input() */
+		avformat_free_context(vidx->formatx);
+		vidx->formatx = NULL;
+	}
+	vidx->stat.bytes   += eio->bytes;
+	vidx->stat.ioseeks += eio->seeks;
+	if (eio->avio) {
+		av_freep(&eio->avio->buffer);
+		av_freep(&eio->avio);
+	}
+#ifdef	HAVE_MMAP
+	if (eio->map) {
+		munmap(eio->map, (size_t) eio->size);
+	}
+#endif
+	if (eio->rabuf) {
+		smm_free(eio->rabuf);
+	}
+	if (eio->fd >= 0) {
+		close(eio->fd);
+	}
+	smm_free(eio);
+#else
+	(void) vidx;
+#endif
+	return EZ_ERR_NONE;
+}
+
+/* tell the I/O backend how the file would be read. The sequential 
+ * pattern reads ahead by large blocks while the random pattern only 
+ * reads what the demuxer asked for */
+static int video_io_pattern(EZVID *vidx, int pattern)
+{
+#ifdef	EZ_IO_BACKEND
+	EZIO	*eio = vidx->ioctx;
+
+	if ((eio == NULL) || (eio->pattern == pattern)) {
+		return EZ_ERR_NONE;
+	}
+	eio->pattern = pattern;
+#ifdef	HAVE_MMAP
+	if (eio->map) {
+		madvise(eio->map, (size_t) eio->size, 
+				pattern == EZ_IO_RANDOM ? 
+				MADV_RANDOM : MADV_SEQUENTIAL);
+	}
+#endif
+#ifdef	HAVE_POSIX_FADVISE
+	posix_fadvise(eio->fd, 0, 0, pattern == EZ_IO_RANDOM ?
+			POSIX_FADV_RANDOM : POSIX_FADV_SEQUENTIAL);
+#endif
+	CDB_MODL(("video_io_pattern: %s\n", 
+			pattern == EZ_IO_RANDOM ? "random" : "sequential"));
+#else
+	(void) vidx; (void) pattern;
+#endif
+	return EZ_ERR_NONE;
+}
+
+#ifdef	EZ_IO_BACKEND
+static int video_io_read(void *opaque, uint8_t *buf, int size)
+{
+	EZIO	*eio = opaque;
+	int64_t	off;
+	int	n;
+
+	if (eio->map) {
+		if (eio->pos >= eio->size) {
+			return AVERROR_EOF;
+		}
+		if (size > eio->size - eio->pos) {
+			size = (int)(eio->size - eio->pos);
+		}
+		memcpy(buf, eio->map + eio->pos, size);
+		n = size;
+	} else if (eio->pattern == EZ_IO_RANDOM) {
+		if ((n = pread(eio->fd, buf, size, eio->pos)) < 0) {
+			return AVERROR(errno);
+		}
+	} else {
+		/* serve from the read ahead block, refill it if missed */
+		off = eio->pos - eio->rapos;
+		if ((off < 0) || (off >= eio->ralen)) {
+			eio->rapos = eio->pos;
+			eio->ralen = pread(eio->fd, eio->rabuf, 
+					EZ_IO_READAHEAD, eio->pos);
+			if (eio->ralen < 0) {
+				eio->ralen = 0;
+				return AVERROR(errno);
+			}
+			off = 0;
+		}
+		if ((n = eio->ralen - (int) off) > size) {
+			n = size;
+		}
+		memcpy(buf, eio->rabuf + off, n);
+	}
+	if (n == 0) {
+		return AVERROR_EOF;
+	}
+	eio->pos   += n;
+	eio->bytes += n;
+	return n;
+}
+
+static int64_t video_io_seek(void *opaque, int64_t offset, int whence)
+{
+	EZIO	*eio = opaque;
+
+	struct	stat	fs;
+
+	/* the file could be growing while it's read by pread() so the size
+	 * is refreshed. The mapped file can only be read within the map */
+	if ((eio->map == NULL) && ((whence & ~AVSEEK_FORCE) != SEEK_SET) &&
+			!fstat(eio->fd, &fs)) {
+		eio->size = (int64_t) fs.st_size;
+	}
+	switch (whence & ~AVSEEK_FORCE) {
+	case AVSEEK_SIZE:
+		return eio->size;
+	case SEEK_SET:
+		break;
+	case SEEK_CUR:
+		offset += eio->pos;
+		break;
+	case SEEK_END:
+		offset += eio->size;
+		break;
+	default:
+		return -1;
+	}
+	if (offset < 0) {
+		return AVERROR(EINVAL);
+	}
+	if (offset != eio->pos) {
+		eio->seeks++;
+	}
+	eio->pos = offset;
+	return offset;
+}
+#endif
+
+/* 20181018 open the decoder of the video stream, or reopen it if it has 
+ * been opened. The 'lowres' is the level of the decoding resolution. 
+ * Each level halves the width and height of the decoded frames */
+static int video_codec_open(EZVID *vidx, int lowres)
+{
+	AVCodec	*codec;
+
+#ifdef	HAVE_AVS_CODECPAR
+	if (vidx->codecx) {
+		avcodec_free_context(&vidx->codecx);
+	}
+	codec = avcodec_find_decoder(vidx->vstream->codecpar->codec_id);
+	vidx->codecx = avcodec_alloc_context3(codec);
+	avcodec_parameters_to_context(vidx->codecx, vidx->vstream->codecpar);
+	av_codec_set_pkt_timebase(vidx->codecx, vidx->vstream->time_base);
+	vidx->codecx->framerate = vidx->vstream->avg_frame_rate;
+#else
+	if (vidx->codecx) {
+		avcodec_close(vidx->codecx);
+	}
+	vidx->codecx  = vidx->vstream->codec;
+	codec = avcodec_find_decoder(vidx->codecx->codec_id);
+#endif
+	/* discard frames; AVDISCARD_NONKEY,AVDISCARD_BIDIR */
+	//vidx->codecx->skip_frame = AVDISCARD_NONREF | AVDISCARD_BIDIR;
+	//vidx->codecx->hurry_up = 1; /* fast decoding mode */
+	/* 20181017 see video_decode_skip() for discarding frames */
+	vidx->skipping = 0;
+	vidx->codecx->lowres = vidx->lowres = lowres;
+	video_threading(vidx);
+#ifdef	HAVE_AVCODEC_OPEN2
+	if (avcodec_open2(vidx->codecx, codec, NULL) < 0) {
+#elif	defined(HAVE_AVCODEC_OPEN)
+	if (avcodec_open(vidx->codecx, codec) < 0) {
+#else
+#error	None of avcodec_open2() or avcodec_open() defined!
+#endif
+		eznotify(vidx->sysopt, EZ_ERR_CODEC_FAIL, 
+				vidx->codecx->codec_id, 0, vidx->codecx);
+		return EZ_ERR_CODEC_FAIL;
+	}
+	return EZ_ERR_NONE;
+}
+
+/* 20181018 If the shots were much smaller than the video, say a quarter
+ * of the width, the decoder could decode the frames in low resolution 
+ * where the codec supports it, which saves the time of decoding and 
+ * scaling. The decoded frames are kept at least twice of the shots so
+ * the quality of the downscaling is still acceptable */
+static int video_lowres(EZVID *vidx, EZIMG *image)
+{
+	int	lowres, maxres;
+
+	if (!(vidx->sysopt->flags & EZOP_LOWRES) || !vidx->codecx->codec) {
+		return 0;
+	}
+#ifdef	HAVE_AV_CODEC_GET_MAX_LOWRES
+	maxres = av_codec_get_max_lowres(vidx->codecx->codec);
+#else
+	maxres = vidx->codecx->codec->max_lowres;
+#endif
+	for (lowres = 0; lowres < maxres; lowres++) {
+		if (EZ_LOWRES(vidx->width, lowres + 1) < image->dst_width*2) {
+			break;
+		}
+		if (EZ_LOWRES(vidx->height, lowres + 1) < image->dst_height*2) {
+			break;
+		}
+	}
+	if (lowres == vidx->lowres) {
+		return lowres;
+	}
+	CDB_DEBUG(("video_lowres: %d (%d)\n", lowres, maxres));
+	if (video_codec_open(vidx, lowres) != EZ_ERR_NONE) {
+		/* roll back to the full resolution */
+		if (video_codec_open(vidx, 0) != EZ_ERR_NONE) {
+			return -1;
+		}
+	}
+	return vidx->lowres;
+}
+
+/* 20181014 rewind the opened media to the beginning so it doesn't need to
+ * be closed and reopened. The MPEG-TS like streams prefer the byte seeking
+ * because their timestamps could be discontinued. If the media can not be 
+ * seeked at all, or the seeking failed, it falls back to reopen the media */
+static int video_rewind(EZVID *vidx)
+{
+	AVFormatContext	*formatx = vidx->formatx;
+	int64_t	start, tmark;
+	int	i, rc, acc, saved;
+
+	if ((formatx == NULL) || (vidx->codecx == NULL)) {
+		return video_open(vidx);
+	}
+
+	video_timing(vidx, EZ_PTS_CLEAR);
+	rc = -1;
+	tmark = av_gettime();
+	if (vidx->seekable != ENX_SEEK_NONE) {
+		vidx->stat.seeks++;
+		if ((formatx->iformat->flags & AVFMT_TS_DISCONT) &&
+				!(formatx->iformat->flags & AVFMT_NO_BYTE_SEEK)) {
+			rc = av_seek_frame(formatx, -1, 0, AVSEEK_FLAG_BYTE);
+		}
+		if (rc < 0) {
+			start = formatx->start_time;
+			if (start == (int64_t)AV_NOPTS_VALUE) {
+				start = 0;
+			}
+			rc = avformat_seek_file(formatx, -1, 
+					INT64_MIN, start, start, 0);
+		}
+		if ((rc < 0) && 
+				!(formatx->iformat->flags & AVFMT_NO_BYTE_SEEK)) {
+			rc = av_seek_frame(formatx, -1, 0, AVSEEK_FLAG_BYTE);
+		}
+	}
+	vidx->stat.t_seek += av_gettime() - tmark;
+	if (rc < 0) {
+		CDB_DEBUG(("video_rewind: failed, reopen the media\n"));
+		video_close(vidx);
+		return video_open(vidx);
+	}
+
+	avcodec_flush_buffers(vidx->codecx);
+	video_keyframe_credit(vidx, -1);
+	video_frame_reset(vidx);
+
+	/* the saved time is the cost of the media and codec opening */
+	for (i = saved = 0; i < vidx->pidx; i++) {
+		if ((vidx->pts[i*2] == EZ_PTS_MOPEN) || 
+				(vidx->pts[i*2] == EZ_PTS_COPEN)) {
+			saved += vidx->pts[i*2+1];
+		}
+	}
+	acc = video_timing(vidx, EZ_PTS_REWIND);
+	if (vidx->pidx < EZ_PTS_MAX) {
+		vidx->pts[vidx->pidx*2]   = EZ_PTS_SAVED;
+		vidx->pts[vidx->pidx*2+1] = saved - acc;
+		vidx->pidx++;
+	}
+	return EZ_ERR_NONE;
+}
+
+/* 20181013 setup the threading model of the decoder before opening it.
+ * The frame threading delays the output by one frame per thread, which 
+ * only pays off when every frame would be decoded, ie. the accurate mode.
+ * Otherwise it decodes only a few frames after each seeking so the slice
+ * threading is preferred. In the job mode the processors were shared by
+ * the workers so the decoder threads were divided by the number of jobs */
+static int video_threading(EZVID *vidx)
+{
+	EZOPT	*ezopt = vidx->sysopt;
+	int	threads, type;
+
+	threads = ezopt->dec_threads;
+#ifdef	HAVE_AV_CPU_COUNT
+	if ((threads <= 0) && (ezopt->jobs > 1)) {
+		threads = av_cpu_count() / ezopt->jobs;
+		if (threads < 1) {
+			threads = 1;
+		}
+	}
+#endif
+	if (threads < 0) {
+		threads = 0;	/* let the decoder decide */
+	}
+
+	switch (EZOP_THREAD_GET(vidx->ses_flags)) {
+	case EZOP_THREAD_OFF:
+		threads = 1;
+		type = FF_THREAD_SLICE;
+		break;
+	case EZOP_THREAD_FRAME:
+		type = FF_THREAD_FRAME;
+		break;
+	case EZOP_THREAD_SLICE:
+		type = FF_THREAD_SLICE;
+		break;
+	default:
+		if (GETACCUR(vidx->ses_flags)) {
+			type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+		} else {
+			type = FF_THREAD_SLICE;
+		}
+		break;
+	}
+
+	vidx->codecx->thread_count = threads;
+	vidx->codecx->thread_type  = type;
+	CDB_DEBUG(("video_threading: %d threads (%d)\n", threads, type));
+	return threads;
+}
+
+/* 20181018 choose the scaler by the quality tier. In the auto mode the
+ * Lanczos is only used when the shots are close to the decoded frames. 
+ * Beyond 4 times downscaling the bicubic filter, which widens by the 
+ * ratio as well, is expected to be hardly distinguishable but much 
+ * cheaper. It's not the default until 'make bench' proved it */
+static int video_scaler(EZVID *vidx, EZIMG *image, int width, int height)
+{
+	int	tier, ratio, flags;
+
+	tier = EZOP_SCALE_GET(vidx->ses_flags);
+	if (tier == EZOP_SCALE_AUTO) {
+		/* the downscale ratio of the larger side */
+		ratio = width / image->dst_width;
+		if (ratio < height / image->dst_height) {
+			ratio = height / image->dst_height;
+		}
+		tier = (ratio >= 4) ? EZOP_SCALE_BALANCED : EZOP_SCALE_BEST;
+	}
+
+	switch (tier) {
+	case EZOP_SCALE_FAST:
+		flags = SWS_FAST_BILINEAR;
+		break;
+	case EZOP_SCALE_BALANCED:
+		flags = SWS_BICUBIC;
+		break;
+	default:
+		flags = SWS_LANCZOS | SWS_ACCURATE_RND;
+		break;
+	}
+	CDB_DEBUG(("video_scaler: %dx%d -> %dx%d (0x%x)\n", width, height,
+			image->dst_width, image->dst_height, flags));
+	return flags;
+}
+
+/* scale the same frame by the Lanczos and add up the PSNR of the current
+ * scaler against it. It only works if the 'scale_bench' was set */
+static int video_scaler_bench(EZVID *vidx, AVFrame *frame, int idx, int us)
+{
+	unsigned char	*dst, *ref;
+	double	mse = 0, psnr;
+	int	i, len, diff;
+
+	(void) idx; (void) us;	/* stop the gcc warning */
+	if (vidx->refframe == NULL) {
+		return -1;
+	}
+	sws_scale(vidx->refframe->context, 
+			(const uint8_t * const *) frame->data,
+			frame->linesize, 0, vidx->vidframe->height, 
+			vidx->refframe->frame->data, 
+			vidx->refframe->frame->linesize);
+
+	dst = vidx->swsframe->rf_buffer;
+	ref = vidx->refframe->rf_buffer;
+	len = vidx->swsframe->frame->linesize[0] * vidx->swsframe->height;
+	for (i = 0; i < len; i++) {
+		diff = dst[i] - ref[i];
+		mse += diff * diff;
+	}
+	mse /= len;
+	psnr = (mse > 0) ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+	vidx->stat.psnr += psnr;
+	vidx->stat.psnr_num++;
+	CDB_DEBUG(("SCALE %d: %d us, PSNR %.2f dB\n", idx, us, psnr));
+	return 0;
+}
+
+/* 20181015 The probe cache keeps the results of video_duration() and the
+ * key frame statistics in a small file for each media, so the second run
+ * on the same video library could skip the expensive scanning. The cache
+ * file was named by the CRC32 of the full path and only valid when the
+ * size, the modify time and the duration mode were all matched */
+static int video_probe_load(EZVID *vidx)
+{
+	KEYCB	*cfg;
+	char	*path, *s, fname[32], stamp[128];
+	long long	val;
+	int	len;
+
+	if ((path = video_probe_key(vidx, fname, stamp)) == NULL) {
+		return EZ_ERR_FILE;
+	}
+	cfg = csc_cfg_open(SMM_CFGROOT_DESKTOP, EZ_PROBE_PATH, 
+			fname, CSC_CFG_READ);
+	if (cfg == NULL) {
+		smm_free(path);
+		return EZ_ERR_FILE;
+	}
+	if (((s = csc_cfg_read(cfg, NULL, "media_path")) == NULL) ||
+			strcmp(s, path) ||
+			((s = csc_cfg_read(cfg, NULL, "media_stamp")) == NULL) ||
+			strcmp(s, stamp) ||
+			csc_cfg_read_longlong(cfg, NULL, "duration", &val)) {
+		CDB_DEBUG(("video_probe_load: %s expired\n", fname));
+		csc_cfg_close(cfg);
+		smm_free(path);
+		return EZ_ERR_FILE;
+	}
+	vidx->duration = (EZTIME) val;
+	csc_cfg_read_int(cfg, NULL, "seekable", &vidx->seekable);
+	csc_cfg_read_int(cfg, NULL, "bitrates", &vidx->bitrates);
+	if (csc_cfg_read_longlong(cfg, NULL, "keygap", &val) == 0) {
+		vidx->keygap = (int64_t) val;
+	}
+	if (csc_cfg_read_longlong(cfg, NULL, "keyalldts", &val) == 0) {
+		vidx->keyalldts = (int64_t) val;
+	}
+	if (csc_cfg_read_longlong(cfg, NULL, "keyallkey", &val) == 0) {
+		vidx->keyallkey = (int64_t) val;
+	}
+	if (vidx->keyallkey > 0) {
+		vidx->keydts = vidx->keyalldts / vidx->keyallkey;
+	}
+	vidx->keyidx = csc_cfg_copy_block(cfg, "keyframe_index", &len);
+	if (vidx->keyidx) {
+		vidx->keynum = vidx->keymax = len / sizeof(EZKEY);
+	}
+	CDB_DEBUG(("video_probe_load: %s %lld ms\n", fname, 
+				(long long) vidx->duration));
+	csc_cfg_close(cfg);
+	smm_free(path);
+	return EZ_ERR_NONE;
+}
+
+static int video_probe_save(EZVID *vidx)
+{
+	KEYCB	*cfg;
+	char	*path, fname[32], stamp[128];
+	int64_t	alldts, allkey;
+
+	if ((path = video_probe_key(vidx, fname, stamp)) == NULL) {
+		return EZ_ERR_FILE;
+	}
+	cfg = csc_cfg_open(SMM_CFGROOT_DESKTOP, EZ_PROBE_PATH, 
+			fname, CSC_CFG_RWC);
+	if (cfg == NULL) {
+		smm_free(path);
+		return EZ_ERR_FILE;
+	}
+
+	/* top up the current crediting session */
+	alldts = vidx->keyalldts;
+	allkey = vidx->keyallkey;
+	if (vidx->keylast >= 0) {
+		alldts += vidx->keylast - vidx->keyfirst;
+		allkey += vidx->keycount;
+	}
+
+	csc_cfg_write(cfg, NULL, "media_path", path);
+	csc_cfg_write(cfg, NULL, "media_stamp", stamp);
+	csc_cfg_write_longlong(cfg, NULL, "duration", 
+			(long long) vidx->duration);
+	csc_cfg_write_int(cfg, NULL, "seekable", vidx->seekable);
+	csc_cfg_write_int(cfg, NULL, "bitrates", vidx->bitrates);
+	csc_cfg_write_longlong(cfg, NULL, "keygap", (long long) vidx->keygap);
+	csc_cfg_write_longlong(cfg, NULL, "keyalldts", (long long) alldts);
+	csc_cfg_write_longlong(cfg, NULL, "keyallkey", (long long) allkey);
+	if (vidx->keynum > 0) {
+		csc_cfg_write_block(cfg, "keyframe_index", vidx->keyidx, 
+				vidx->keynum * sizeof(EZKEY));
+	}
+	csc_cfg_save(cfg);
+	csc_cfg_close(cfg);
+	smm_free(path);
+	return EZ_ERR_NONE;
+}
+
+/* return the full path of the media, which should be freed by smm_free().
+ * The 'fname' receives the name of the cache file and the 'stamp' receives
+ * the fingerprint of the media */
+static char *video_probe_key(EZVID *vidx, char *fname, char *stamp)
+{
+	struct	stat	fs;
+	char	*path;
+	int	len;
+
+	if (stat(vidx->filename, &fs) < 0) {
+		return NULL;
+	}
+
+	len = strlen(vidx->filename);
+	if (csc_isdelim(SMM_PATH_DELIM, vidx->filename[0]) ||
+			((len > 1) && (vidx->filename[1] == ':'))) {
+		path = csc_strcpy_alloc(vidx->filename, 0);
+	} else if ((path = smm_cwd_alloc(len + 4)) != NULL) {
+		strcat(path, SMM_DEF_DELIM);
+		strcat(path, vidx->filename);
+	}
+	if (path == NULL) {
+		return NULL;
+	}
+
+	sprintf(fname, "%08lx.cache", 
+			csc_crc32(0, path, strlen(path)) & 0xffffffffUL);
+	sprintf(stamp, "%lld %lld %d", (long long) vidx->filesize, 
+			(long long) fs.st_mtime, 
+			GETDURMOD(vidx->ses_flags) >> 12);
+	return path;
+}
+
+static int video_connect(EZVID *vidx, EZIMG *image)
+{
+	int	width, height;
+
+	if (video_lowres(vidx, image) < 0) {
+		eznotify(vidx->sysopt, EZ_ERR_VIDEOSTREAM, 
+				0, 0, vidx->filename);
+		return EZ_ERR_CODEC_FAIL;
+	}
+	/* the size of the decoded frames */
+	width  = EZ_LOWRES(vidx->width, vidx->lowres);
+	height = EZ_LOWRES(vidx->height, vidx->lowres);
+
+#ifdef	EZ_FRAME_REFCOUNT
+	/* the picframe only refers to the buffer of the decoded frame */
+	vidx->picframe = video_frame_alloc(0, 0, 0);
+#else
+	vidx->picframe = video_frame_alloc(vidx->codecx->pix_fmt, 
+			width, height);
+#endif
+	if (vidx->picframe == NULL) {
+		eznotify(vidx->sysopt, EZ_ERR_VIDEOSTREAM, 
+				0, 0, vidx->filename);
+		return EZ_ERR_LOWMEM;
+	}
+	vidx->picframe->pixfmt = vidx->codecx->pix_fmt;
+	vidx->picframe->width  = width;
+	vidx->picframe->height = height;
 
 	if ((vidx->vidframe = video_frame_alloc(0, 0, 0)) == NULL) {
 		video_frame_free(&vidx->picframe);
@@ -1557,8 +3067,8 @@ static int video_connect(EZVID *vidx, EZIMG *image)
 		return EZ_ERR_LOWMEM;
 	}
 	vidx->vidframe->pixfmt = vidx->codecx->pix_fmt;
-	vidx->vidframe->width  = vidx->width;
-	vidx->vidframe->height = vidx->height;
+	vidx->vidframe->width  = width;
+	vidx->vidframe->height = height;
 
 	/* allocate the frame structure for RGB converter which
 	 * will be filled by frames converted from YUV form */
@@ -1567,11 +3077,10 @@ static int video_connect(EZVID *vidx, EZIMG *image)
 	if (vidx->swsframe) {
 		/* the swscale structure for scaling the screen image */
 		vidx->swsframe->context = sws_getContext(
-				vidx->width, vidx->height, 
-				vidx->codecx->pix_fmt,
+				width, height, vidx->codecx->pix_fmt,
 				image->dst_width, image->dst_height, 
 				image->dst_pixfmt, 
-				SWS_LANCZOS|SWS_ACCURATE_RND,  //SWS_BILINEAR
+				video_scaler(vidx, image, width, height),
 				NULL, NULL, NULL);
 		if (vidx->swsframe->context == NULL) {
 			video_frame_free(&vidx->swsframe);
@@ -1583,18 +3092,32 @@ static int video_connect(EZVID *vidx, EZIMG *image)
 		return EZ_ERR_SWSCALE;
 	}
 
+	if (vidx->sysopt->scale_bench) {
+		vidx->refframe = video_frame_alloc(image->dst_pixfmt,
+				image->dst_width, image->dst_height);
+	}
+	if (vidx->refframe) {
+		vidx->refframe->context = sws_getContext(
+				width, height, vidx->codecx->pix_fmt,
+				image->dst_width, image->dst_height, 
+				image->dst_pixfmt, 
+				SWS_LANCZOS|SWS_ACCURATE_RND,
+				NULL, NULL, NULL);
+		if (vidx->refframe->context == NULL) {
+			video_frame_free(&vidx->refframe);
+		}
+	}
+
 	/* frame image capture device for debugging only */
 #ifdef	CFG_SNAPSHOT_DUMP
-	vidx->capgdimg = gdImageCreateTrueColor(vidx->width, vidx->height);
+	vidx->capgdimg = gdImageCreateTrueColor(width, height);
 #endif
 #if	defined(CFG_SNAPSHOT_DUMP) || defined(CFG_SNAPSHOT_RGB)
-	vidx->capframe = video_frame_alloc(PIX_FMT_RGB24, 
-				vidx->width, vidx->height);
+	vidx->capframe = video_frame_alloc(PIX_FMT_RGB24, width, height);
 	if (vidx->capframe) {
 		vidx->capframe->context = sws_getContext(
-				vidx->width, vidx->height,
-				vidx->codecx->pix_fmt,
-				vidx->width, vidx->height, PIX_FMT_RGB24,
+				width, height, vidx->codecx->pix_fmt,
+				width, height, PIX_FMT_RGB24,
 				SWS_BILINEAR, NULL, NULL, NULL);
 		if (vidx->capframe->context == NULL) {
 			video_frame_free(&vidx->capframe);
@@ -1606,6 +3129,11 @@ static int video_connect(EZVID *vidx, EZIMG *image)
 
 static int video_disconnect(EZVID *vidx)
 {
+	video_pipe_close(vidx);
+	if (vidx->refframe) {
+		sws_freeContext(vidx->refframe->context);
+		video_frame_free(&vidx->refframe);
+	}
 	if (vidx->swsframe) {
 		if (vidx->swsframe->context) {
 			sws_freeContext(vidx->swsframe->context);
@@ -1802,25 +3330,227 @@ static int video_keyframe_credit(EZVID *vidx, int64_t dts)
 	return vidx->keycount;
 }
 
-static int video_dts_ruler(EZVID *vidx, int64_t cdts, int64_t ndts)
+static int video_dts_ruler(EZVID *vidx, int64_t cdts, int64_t ndts)
+{
+	int64_t	span;
+	int	n;
+
+	if (ndts > cdts) {
+		span = ndts - cdts;
+	} else {
+		span = cdts - ndts;
+	}
+	if (vidx->keygap > 0) {
+		n = (int)(span / vidx->keygap);
+	} else if (vidx->keygap < 0) {
+		n = INT_MAX;	/* accredit system is not ready */
+	} else {
+		n = 0;	/* one i-frame only */
+	}
+	//printf("video_dts_ruler: %lld %lld %d\n", cdts, ndts, n);
+	return n;
+}
+
+/* 20181016 The key frame index records the DTS and the byte position of 
+ * every key frame in the video stream while video_statistics() reading
+ * through the file. It's abandoned if the DTS were not in order, for
+ * example, the rewound DTS in the MPEG-TS streams */
+static int video_keyidx_add(EZVID *vidx, int64_t dts, int64_t pos)
+{
+	EZKEY	*kidx;
+
+	if ((vidx->keymax < 0) || (dts == (int64_t)AV_NOPTS_VALUE)) {
+		return vidx->keynum;
+	}
+	if (vidx->keynum && (dts <= vidx->keyidx[vidx->keynum-1].dts)) {
+		CDB_DEBUG(("video_keyidx_add: disordered %lld\n", dts));
+		vidx->keyidx = smm_free(vidx->keyidx);
+		vidx->keynum = 0;
+		vidx->keymax = -1;
+		return -1;
+	}
+	if (vidx->keynum >= vidx->keymax) {
+		kidx = smm_alloc((vidx->keymax + 1024) * sizeof(EZKEY));
+		if (kidx == NULL) {
+			return vidx->keynum;	/* leave it partial */
+		}
+		if (vidx->keyidx) {
+			memcpy(kidx, vidx->keyidx, vidx->keynum * sizeof(EZKEY));
+			smm_free(vidx->keyidx);
+		}
+		vidx->keyidx = kidx;
+		vidx->keymax += 1024;
+	}
+	vidx->keyidx[vidx->keynum].dts = dts;
+	vidx->keyidx[vidx->keynum].pos = pos;
+	return ++vidx->keynum;
+}
+
+/* find the last key frame which is not after the 'dts' */
+static EZKEY *video_keyidx_find(EZVID *vidx, int64_t dts)
+{
+	int	lo, hi, mid;
+
+	if ((vidx->keynum <= 0) || (dts < vidx->keyidx[0].dts)) {
+		return NULL;
+	}
+	lo = 0;
+	hi = vidx->keynum - 1;
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (vidx->keyidx[mid].dts <= dts) {
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		}
+	}
+	return &vidx->keyidx[lo];
+}
+
+/* The MPEG-TS like streams could be seeked by the byte position because
+ * the demuxer would resync itself. It works even the timestamp seeking
+ * was failed by video_seek_challenge(). Other seekable containers could
+ * only be seeked by the exact DTS of the key frame */
+static int video_keyidx_seek(EZVID *vidx, EZKEY *key)
+{
+	AVFormatContext	*formatx = vidx->formatx;
+	int	rc = -1;
+
+	if (key == NULL) {
+		return -1;
+	}
+	if ((key->pos >= 0) && (formatx->iformat->flags & AVFMT_TS_DISCONT) &&
+			!(formatx->iformat->flags & AVFMT_NO_BYTE_SEEK)) {
+		rc = av_seek_frame(formatx, -1, key->pos, AVSEEK_FLAG_BYTE);
+	} else if (SEEKABLE(vidx->seekable)) {
+		rc = avformat_seek_file(formatx, vidx->vsidx, 
+				key->dts, key->dts, key->dts, 0);
+	}
+	CDB_PROG(("video_keyidx_seek: %lld @ %lld (%d)\n", 
+				key->dts, key->pos, rc));
+	return rc;
+}
+
+/* jump forward to the key frame just before the 'dts' if it's beyond the
+ * current position 'from'. Return the DTS of the key frame or -1 */
+static int64_t video_keyidx_jump(EZVID *vidx, int64_t dts, int64_t from)
+{
+	EZKEY	*key;
+
+	if ((key = video_keyidx_find(vidx, dts)) == NULL) {
+		return -1;
+	}
+	if ((key->dts <= from) || (video_keyidx_seek(vidx, key) < 0)) {
+		return -1;
+	}
+	avcodec_flush_buffers(vidx->codecx);
+	video_keyframe_credit(vidx, -1);
+	video_frame_reset(vidx);
+	return key->dts;
+}
+
+/* 20181018 Most of the seekable containers, like MP4, MKV with cues or AVI
+ * with idx1, have already told the demuxer where every key frame is in 
+ * the header. If the index covered the whole video stream, the key frame
+ * index, the key frame statistics and the duration could be taken from it
+ * directly without any challenge or scanning. The index was regarded as
+ * incomplete if it started or ended far from the stream, for example, the
+ * MKV whose cues were not loaded yet, or the MPEG-TS which index was only
+ * built while reading */
+static int video_index_load(EZVID *vidx)
 {
-	int64_t	span;
-	int	n;
+	AVStream	*st = vidx->vstream;
+	const AVIndexEntry	*ie;
+	int64_t	tmark, first, last, tail, margin;
+	int	i, num, nonkey;
+
+	tmark = av_gettime();
+#ifdef	HAVE_AVFORMAT_INDEX_GET_ENTRY
+	num = avformat_index_get_entries_count(st);
+#else
+	num = st->nb_index_entries;
+#endif
+	if (num < 2) {
+		return EZ_ERR_FILE;
+	}
 
-	if (ndts > cdts) {
-		span = ndts - cdts;
-	} else {
-		span = cdts - ndts;
+	vidx->keyidx = smm_free(vidx->keyidx);
+	vidx->keynum = vidx->keymax = 0;
+	vidx->keygap = 0;
+	first = last = tail = -1;
+	for (i = nonkey = 0; i < num; i++) {
+#ifdef	HAVE_AVFORMAT_INDEX_GET_ENTRY
+		ie = avformat_index_get_entry(st, i);
+#else
+		ie = &st->index_entries[i];
+#endif
+		if ((ie == NULL) || (ie->timestamp == (int64_t)AV_NOPTS_VALUE)) {
+			continue;
+		}
+		if (ie->timestamp > tail) {
+			tail = ie->timestamp;
+		}
+		if (!(ie->flags & AVINDEX_KEYFRAME)) {
+			nonkey = 1;	/* the index lists the non-key frames too */
+			continue;
+		}
+		if (video_keyidx_add(vidx, ie->timestamp, ie->pos) < 0) {
+			goto vi_load_failed;	/* disordered index */
+		}
+		if ((last >= 0) && (ie->timestamp - last > vidx->keygap)) {
+			vidx->keygap = ie->timestamp - last;
+		}
+		if (first < 0) {
+			first = ie->timestamp;
+		}
+		last = ie->timestamp;
 	}
-	if (vidx->keygap > 0) {
-		n = (int)(span / vidx->keygap);
-	} else if (vidx->keygap < 0) {
-		n = INT_MAX;	/* accredit system is not ready */
-	} else {
-		n = 0;	/* one i-frame only */
+	if (vidx->keynum < 2) {
+		goto vi_load_failed;
 	}
-	//printf("video_dts_ruler: %lld %lld %d\n", cdts, ndts, n);
-	return n;
+
+	/* the index must cover both ends of the stream within a key frame
+	 * gap, or 10 seconds if the key frames were sparse */
+	vidx->duration = 
+		(EZTIME)(vidx->formatx->duration / AV_TIME_BASE * 1000);
+	margin = vidx->keygap;
+	if (margin < video_ms_to_dts(vidx, 10000)) {
+		margin = video_ms_to_dts(vidx, 10000);
+	}
+	if ((vidx->duration <= 0) || (first - vidx->dts_offset > margin) ||
+			(vidx->dts_offset + video_ms_to_dts(vidx, 
+			vidx->duration) - last > margin)) {
+		CDB_DEBUG(("video_index_load: incomplete %lld-%lld/%lld\n",
+				first, last, vidx->duration));
+		goto vi_load_failed;
+	}
+
+	vidx->keyalldts = last - first;
+	vidx->keyallkey = vidx->keynum - 1;
+	vidx->keydts = vidx->keyalldts / vidx->keyallkey;
+	if (nonkey) {
+		/* the last frame in the index ends the stream */
+		vidx->duration = video_dts_to_ms(vidx, 
+				tail - vidx->dts_offset + vidx->dts_rate);
+	}
+	vidx->seekable = ENX_SEEK_FREE;
+	vidx->bitrates = (int)(vidx->filesize * 8000 / vidx->duration);
+	vidx->stat.t_duration += av_gettime() - tmark;
+
+	eznotify(vidx->sysopt, EN_DURATION, 0,
+			smm_time_diff(&vidx->tmark), vidx);
+	CDB_PROG(("video_index_load: %lld K:%d G:%lld BR:%d\n", 
+			vidx->duration, vidx->keynum, vidx->keygap,
+			vidx->bitrates));
+	return EZ_ERR_NONE;
+
+vi_load_failed:
+	/* drop the partial index so the challenge and the scanning start 
+	 * from a clean state */
+	vidx->keyidx = smm_free(vidx->keyidx);
+	vidx->keynum = vidx->keymax = 0;
+	vidx->keygap = -1;
+	return EZ_ERR_FILE;
 }
 
 /* 20130726 Integrated the key frame accrediting into video_load_packet()
@@ -1833,6 +3563,7 @@ static int64_t video_load_packet(EZVID *vidx, AVPacket *packet)
 	int64_t	dts;
 
 	while (av_read_frame(vidx->formatx, packet) >= 0) {
+		vidx->stat.packets++;
 		if (packet->stream_index != vidx->vsidx) {
 			video_free_packet(packet);
 			continue;
@@ -2001,10 +3732,12 @@ char *video_media_in_buffer(EZVID *vidx, char *buf, int blen)
 static EZTIME video_duration(EZVID *vidx)
 {
 	EZIMG	*image;
-	int64_t	ref_dur;
+	int64_t	ref_dur, tmark, tchal;
 	int	ref_err, shots, key_num;
 
 	video_timing(vidx, EZ_PTS_CLEAR);
+	tmark = av_gettime();
+	tchal = 0;
 
 	/* find the duration in the header */
 	vidx->seekable = ENX_SEEK_UNKNOWN;
@@ -2024,10 +3757,15 @@ static EZTIME video_duration(EZVID *vidx)
 
 	case EZOP_DUR_QSCAN:
 		/* test the seekability of the media file */
+		tchal = av_gettime();
 		vidx->seekable = video_seek_challenge(vidx);
+		tchal = av_gettime() - tchal;
 		video_timing(vidx, EZ_PTS_DSEEK);
 		if (vidx->seekable == ENX_SEEK_UNKNOWN) {
 			CDB_PROG(("video_duration: [Q] scan done\n"));
+		} else if ((ref_dur = video_duration_tailscan(vidx)) > 0) {
+			CDB_PROG(("video_duration: [Q] tailscan\n"));
+			vidx->duration = ref_dur;
 		} else if (!SEEKABLE(vidx->seekable)) {
 			CDB_PROG(("video_duration: [Q] fullscan\n"));
 			vidx->duration = video_duration_fullscan(vidx);
@@ -2043,7 +3781,9 @@ static EZTIME video_duration(EZVID *vidx)
 		break;
 
 	case EZOP_DUR_FSCAN:
+		tchal = av_gettime();
 		vidx->seekable = video_seek_challenge(vidx);
+		tchal = av_gettime() - tchal;
 		video_timing(vidx, EZ_PTS_DSEEK);
 		if (vidx->seekable != ENX_SEEK_UNKNOWN) {
 			vidx->duration = video_duration_fullscan(vidx);
@@ -2053,8 +3793,14 @@ static EZTIME video_duration(EZVID *vidx)
 
 	case EZOP_DUR_AUTO:
 	default:
-		/* test the seekability of the media file */
-		vidx->seekable = video_seek_challenge(vidx);
+		/* test the seekability of the media file unless the 
+		 * container was trusted */
+		tchal = av_gettime();
+		vidx->seekable = video_seek_policy(vidx);
+		if (vidx->seekable == ENX_SEEK_UNKNOWN) {
+			vidx->seekable = video_seek_challenge(vidx);
+		}
+		tchal = av_gettime() - tchal;
 		video_timing(vidx, EZ_PTS_DSEEK);
 		if (vidx->seekable == ENX_SEEK_UNKNOWN) {
 			CDB_PROG(("video_duration: [A] scan done\n"));
@@ -2089,6 +3835,11 @@ static EZTIME video_duration(EZVID *vidx)
 			 * estimated duration is greater than 20%, ezthumb
 			 * will turn to scan mode */
 			break;
+		} else if ((ref_dur = video_duration_tailscan(vidx)) > 0) {
+			CDB_PROG(("video_duration: error %d tailscan\n",
+					ref_err));
+			vidx->duration = ref_dur;
+			video_timing(vidx, EZ_PTS_DSCAN);
 		} else if (!SEEKABLE(vidx->seekable)) {
 			CDB_PROG(("video_duration: error %d fullscan\n",
 					ref_err));
@@ -2108,6 +3859,8 @@ static EZTIME video_duration(EZVID *vidx)
 		break;
 	}
 	vidx->bitrates = (int)(vidx->filesize * 8000 / vidx->duration);
+	vidx->stat.t_challenge += tchal;
+	vidx->stat.t_duration  += av_gettime() - tmark - tchal;
 
 	eznotify(vidx->sysopt, EN_DURATION, 0,
 			smm_time_diff(&vidx->tmark), vidx);
@@ -2129,6 +3882,7 @@ static EZTIME video_duration_quickscan(EZVID *vidx)
 	int		i;
 
 	SETDURMOD(vidx->ses_flags, EZOP_DUR_QSCAN);	/* quick scan */
+	video_io_pattern(vidx, EZ_IO_RANDOM);
 
 	/* using the binary seach to constrain to the start point */
 	rdts = video_ms_to_dts(vidx, vidx->filesize * 8000 / vidx->bitrates);
@@ -2186,6 +3940,248 @@ static EZTIME video_duration_fullscan(EZVID *vidx)
 	return dts;
 }
 
+/* 20181018 The MPEG-TS and MPEG-PS have no reliable duration in the head
+ * but every PES header carries the PTS. Reading the tail of the file by
+ * the byte offset and picking up the last PTS of the video stream gives
+ * the duration in a few milliseconds, rather than the seeking of the
+ * quickscan or the reading through of the fullscan. The PTS is 33-bit so
+ * it may wrap around once against the first PTS */
+static EZTIME video_duration_tailscan(EZVID *vidx)
+{
+	AVIOContext	*pb = vidx->formatx->pb;
+	const char	*name = vidx->formatx->iformat->name;
+	unsigned char	*buf;
+	int64_t	saved, last;
+	int	len, rlen;
+
+	if ((pb == NULL) || (vidx->filesize <= 0) || 
+			!(pb->seekable & AVIO_SEEKABLE_NORMAL)) {
+		return -1;
+	}
+	if (strcmp(name, "mpegts") && strcmp(name, "mpeg")) {
+		return -1;
+	}
+	/* the PTS of PES is always based on 90kHz */
+	if ((vidx->vstream->time_base.num != 1) || 
+			(vidx->vstream->time_base.den != 90000)) {
+		return -1;
+	}
+	if ((buf = smm_alloc(EZ_TAIL_PROBE_MAX)) == NULL) {
+		return -1;
+	}
+
+	saved = avio_tell(pb);
+	last  = -1;
+	for (len = EZ_TAIL_PROBE; len <= EZ_TAIL_PROBE_MAX; len *= 2) {
+		if (len > vidx->filesize) {
+			len = (int) vidx->filesize;
+		}
+		if (avio_seek(pb, vidx->filesize - len, SEEK_SET) < 0) {
+			break;
+		}
+		if ((rlen = avio_read(pb, buf, len)) <= 0) {
+			break;
+		}
+		last = video_tail_last_pts(vidx, buf, rlen);
+		CDB_PROG(("video_duration_tailscan: %d bytes PTS %lld\n",
+				rlen, last));
+		if ((last >= 0) || (len >= vidx->filesize)) {
+			break;
+		}
+	}
+	avio_seek(pb, saved, SEEK_SET);
+	smm_free(buf);
+
+	if (last < 0) {
+		return -1;
+	}
+	/* unwrap the PTS against the first PTS of the stream */
+	if (last < vidx->dts_offset) {
+		last += (int64_t)1 << 33;
+	}
+	if ((last -= vidx->dts_offset) <= 0) {
+		return -1;
+	}
+	SETDURMOD(vidx->ses_flags, EZOP_DUR_QSCAN);
+	return video_dts_to_ms(vidx, last + vidx->dts_rate);
+}
+
+/* find the largest PTS of the video stream in the buffer. The largest
+ * rather than the last one because of the reordered B-frames */
+static int64_t video_tail_last_pts(EZVID *vidx, unsigned char *buf, int len)
+{
+	unsigned char	*p;
+	int64_t	pts, last = -1;
+	int	i, n, psz, vid;
+
+	vid = vidx->vstream->id;
+	if (!strcmp(vidx->formatx->iformat->name, "mpeg")) {
+		/* program stream: the stream id is the PES start code */
+		for (i = 0; i + 14 <= len; i++) {
+			if (buf[i] || buf[i+1] || (buf[i+2] != 1) ||
+					(buf[i+3] != (vid & 0xff))) {
+				continue;
+			}
+			pts = video_tail_pes_pts(buf + i, len - i);
+			if (pts > last) {
+				last = pts;
+			}
+		}
+		return last;
+	}
+
+	/* transport stream: the stream id is the PID. Find the packet size
+	 * (188, 192 of M2TS or 204 with FEC) by 3 continuous sync bytes */
+	for (i = 0; i < 204; i++) {
+		for (psz = 188; psz <= 204; psz += (psz == 188) ? 4 : 12) {
+			if ((i + psz * 2 < len) && (buf[i] == 0x47) && 
+					(buf[i+psz] == 0x47) &&
+					(buf[i+psz*2] == 0x47)) {
+				break;
+			}
+		}
+		if (psz <= 204) {
+			break;
+		}
+	}
+	if (i >= 204) {
+		return -1;
+	}
+	for ( ; i + 188 <= len; i += psz) {
+		p = buf + i;
+		if (p[0] != 0x47) {
+			continue;	/* lost sync; skip the packet */
+		}
+		/* only the packets starting a PES of the video PID */
+		if (!(p[1] & 0x40) || ((((p[1] & 0x1f) << 8) | p[2]) != vid)) {
+			continue;
+		}
+		n = 4;
+		if (p[3] & 0x20) {	/* adaptation field */
+			n += p[4] + 1;
+		}
+		if (!(p[3] & 0x10) || (n >= 188)) {
+			continue;	/* no payload */
+		}
+		pts = video_tail_pes_pts(p + n, 188 - n);
+		if (pts > last) {
+			last = pts;
+		}
+	}
+	return last;
+}
+
+/* extract the PTS from the PES header of MPEG-2 or MPEG-1 */
+static int64_t video_tail_pes_pts(unsigned char *pes, int len)
+{
+	unsigned char	*p;
+
+	if ((len < 14) || pes[0] || pes[1] || (pes[2] != 1)) {
+		return -1;
+	}
+	if ((pes[6] & 0xc0) == 0x80) {		/* MPEG-2 PES */
+		if (!(pes[7] & 0x80)) {
+			return -1;	/* no PTS */
+		}
+		p = pes + 9;
+	} else {				/* MPEG-1 PES */
+		for (p = pes + 6; (*p == 0xff) && (p < pes + len - 8); p++);
+		if ((*p & 0xc0) == 0x40) {	/* STD buffer */
+			p += 2;
+		}
+		if ((p + 5 > pes + len) || ((*p & 0xe0) != 0x20)) {
+			return -1;
+		}
+	}
+	return ((int64_t)(p[0] & 0x0e) << 29) | ((int64_t)p[1] << 22) |
+		((int64_t)(p[2] & 0xfe) << 14) | ((int64_t)p[3] << 7) |
+		((int64_t)p[4] >> 1);
+}
+
+/* 20181018 The well-formed containers which duration came from the 
+ * container itself are known to be seekable by the demuxer, so the trial
+ * seeking of video_seek_challenge() could be skipped. The policy only
+ * reads the first key frames in EZ_DSCP_RANGE_INIT for the key frame rate.
+ * It returns ENX_SEEK_UNKNOWN to leave the suspicious files to the 
+ * challenge, for example, the duration was estimated by the bitrate, or 
+ * the duration of the video stream disagreed with the container */
+static int video_seek_policy(EZVID *vidx)
+{
+#ifdef	HAVE_DURATION_ESTIMATION
+	static	struct	{
+		char	*demuxer;	/* name of the input format */
+		int	method;		/* how the duration was estimated */
+	} trusted[] = {
+		{ "mov,mp4,m4a,3gp,3g2,mj2",	AVFMT_DURATION_FROM_STREAM },
+		{ "matroska,webm",		AVFMT_DURATION_FROM_STREAM },
+		{ NULL, 0 }
+	};
+	AVFormatContext	*formatx = vidx->formatx;
+	AVPacket	packet;
+	EZTIME	sdur;
+	int64_t	cur_dts, dts_target;
+	int	i, err;
+
+	for (i = 0; trusted[i].demuxer; i++) {
+		if (!strcmp(formatx->iformat->name, trusted[i].demuxer) &&
+				((int)formatx->duration_estimation_method ==
+				 trusted[i].method)) {
+			break;
+		}
+	}
+	if (trusted[i].demuxer == NULL) {
+		return ENX_SEEK_UNKNOWN;
+	}
+	if ((vidx->duration <= 0) || (vidx->filesize <= 0)) {
+		return ENX_SEEK_UNKNOWN;
+	}
+	/* the video stream should agree with the container in 20% */
+	if ((vidx->vstream->duration > 0) && (vidx->vstream->duration !=
+				(int64_t)AV_NOPTS_VALUE)) {
+		sdur = video_dts_to_ms(vidx, vidx->vstream->duration);
+		err = (int)((vidx->duration - sdur) * 1000 / vidx->duration);
+		if (abs(err) > 200) {
+			CDB_PROG(("video_seek_policy: disagreed %lld/%lld\n",
+					vidx->duration, sdur));
+			return ENX_SEEK_UNKNOWN;
+		}
+	}
+
+	/* read the first key frames for the key frame rate. Give up if 
+	 * there's less than 2 key frames in the extended range */
+	dts_target = video_ms_to_dts(vidx, EZ_DSCP_RANGE_INIT);
+	dts_target += vidx->dts_offset;
+	video_keyframe_credit(vidx, -1);
+	while ((cur_dts = video_keyframe_next(vidx, &packet)) >= 0) {
+		video_free_packet(&packet);
+		eznotify(vidx->sysopt, EN_OPEN_GOING, 0, 0, NULL);
+		if ((cur_dts > dts_target) && (vidx->keycount > 0)) {
+			break;
+		}
+		if (cur_dts - vidx->dts_offset > (dts_target - 
+				vidx->dts_offset) * EZ_DSCP_RANGE_EXT) {
+			cur_dts = -1;	/* too few key frames */
+			break;
+		}
+	}
+	if (cur_dts < 0) {
+		/* back to the start for the challenge. It's a part of the
+		 * probing, not the rewinding which saves a reopening, so the
+		 * timing of the probing is kept */
+		video_seeking(vidx, 0);
+		return ENX_SEEK_UNKNOWN;
+	}
+	video_keyframe_credit(vidx, -1);
+	vidx->bitrates = (int)(vidx->filesize * 8000 / vidx->duration);
+	CDB_PROG(("video_seek_policy: %s trusted, %lld dts per key frame\n",
+			formatx->iformat->name, vidx->keydts));
+	return ENX_SEEK_FREE;
+#else
+	(void) vidx;
+	return ENX_SEEK_UNKNOWN;
+#endif
+}
+
 static int video_seek_challenge(EZVID *vidx)
 {
 	AVPacket	packet;
@@ -2196,6 +4192,7 @@ static int video_seek_challenge(EZVID *vidx)
 
 	/* initial scan the beginning part of the video up to 10 second
 	 * (EZ_DSCP_RANGE_INIT) and 10 keyframe to calculate the bitrates */
+	video_io_pattern(vidx, EZ_IO_RANDOM);
 	dts_first = pos_first = 0;
 	dts_target = video_ms_to_dts(vidx, EZ_DSCP_RANGE_INIT);
 	dts_target += vidx->dts_offset;
@@ -2301,6 +4298,7 @@ static int video_seek_challenge(EZVID *vidx)
 		 * is quite annoying */
 		avformat_seek_file(vidx->formatx, vidx->vsidx, next_dts, 
 				next_dts, INT64_MAX, AVSEEK_FLAG_ANY);
+		vidx->stat.seeks++;
 		video_keyframe_credit(vidx, -1);
 
 		if ((cur_dts = video_load_packet(vidx, &packet)) < 0) {
@@ -2360,6 +4358,7 @@ static int video_seek_challenge(EZVID *vidx)
 		}
 		avformat_seek_file(vidx->formatx, vidx->vsidx, next_dts, 
 				next_dts, INT64_MAX, AVSEEK_FLAG_ANY);
+		vidx->stat.seeks++;
 		video_keyframe_credit(vidx, -1);
 
 		if ((cur_dts = video_load_packet(vidx, &packet)) < 0) {
@@ -2393,8 +4392,13 @@ static int64_t video_statistics(EZVID *vidx)
 	int		i, imax = 0;
 
 	memset(mestat, 0, sizeof(mestat));
+	video_io_pattern(vidx, EZ_IO_SEQUENTIAL);
 	video_keyframe_credit(vidx, -1);
+	/* rebuild the key frame index while reading through the file */
+	vidx->keyidx = smm_free(vidx->keyidx);
+	vidx->keynum = vidx->keymax = 0;
 	while (av_read_frame(vidx->formatx, &packet) >= 0) {
+		vidx->stat.packets++;
 		i = packet.stream_index;
 		if (i > (int)vidx->formatx->nb_streams) {
 			i = vidx->formatx->nb_streams;
@@ -2412,6 +4416,7 @@ static int64_t video_statistics(EZVID *vidx)
 			mestat[i].key++;
 			if (packet.stream_index == vidx->vsidx) {
 				video_keyframe_credit(vidx, packet.dts);
+				video_keyidx_add(vidx, packet.dts, packet.pos);
 				eznotify(vidx->sysopt, EN_PACKET_KEY, 
 						0, 0, &packet);
 			}
@@ -2492,20 +4497,42 @@ static int video_snap_begin(EZVID *vidx, EZIMG *image, int method)
 	image->gifx_opt = 0;
 #endif
 
+	/* 20181018 the banded canvas streams the bands into the file when
+	 * they are done, so the media information goes first */
+	if (image->band_rows) {
+		image_band_open(image, vidx->filename);
+		if (image->sysopt->flags & EZOP_INFO) {
+			video_media_on_canvas(vidx, image);
+		}
+	}
+
 	eznotify(vidx->sysopt, EN_PROC_BEGIN, method, 0, vidx);
 	return 0;
 }
 
 static int video_snap_update(EZVID *vidx, EZIMG *image, int64_t dts)
 {
-	struct	ezntf	myntf;
 	EZFRM	*ezfrm;
-	char	timestamp[64];
-	EZTIME	dtms;
 
 	if ((ezfrm = video_frame_best(vidx, dts)) == NULL) {
 		return -1;	/* no proper frame */
 	}
+	video_snap_frame(vidx, image, ezfrm, dts);
+
+	/* store the last frame */
+	video_frame_update(vidx);
+	return 0;
+}
+
+/* take the frame as the next shot. The frame could come from the seekers
+ * other than the decoder of the 'vidx' */
+static int video_snap_frame(EZVID *vidx, EZIMG *image, EZFRM *ezfrm, 
+		int64_t dts)
+{
+	struct	ezntf	myntf;
+	char	timestamp[64];
+	EZTIME	dtms;
+
 	myntf.varg1 = vidx;
 	myntf.varg2 = ezfrm;
 	eznotify(vidx->sysopt, EN_FRAME_EFFECT, image->taken, 0, &myntf);
@@ -2525,35 +4552,16 @@ static int video_snap_update(EZVID *vidx, EZIMG *image, int64_t dts)
 		strcat(timestamp, ")");
 	}
 
-	/* scale the frame into GD frame structure */
-	sws_scale(vidx->swsframe->context, 
-			(const uint8_t * const *) ezfrm->frame->data,
-			ezfrm->frame->linesize, 0, vidx->height, 
-			vidx->swsframe->frame->data, 
-			vidx->swsframe->frame->linesize);
-	image_gdframe_update(image, vidx->swsframe->frame);
-
-	/* write the timestamp into the shot */
-	if (image->sysopt->flags & EZOP_TIMEST) {
-		image_gdframe_timestamp(image, timestamp);
-	}
-
-	if (image->gdcanvas) {
-		image_gdcanvas_update(image, image->taken);
-#ifdef	HAVE_GDIMAGEGIFANIMBEGIN
-	} else if (image->gifx_fp) {
-		image_gif_anim_add(image, image->gifx_fp, image->gifx_opt);
-#endif
-	} else {
-		image_gdframe_save(image, vidx->filename, image->taken);
+	/* hand over the frame to the compose stage, or compose it here
+	 * if the pipeline is not available */
+	if (video_pipe_push(vidx, ezfrm->frame, image->taken, timestamp) < 0) {
+		video_snap_compose(vidx, image, ezfrm->frame, 
+				image->taken, timestamp);
 	}
 
 	/* update the number of taken shots, must before displaying */
 	image->taken++;
 
-	/* store the last frame */
-	video_frame_update(vidx);
-
 	/* display the on-going information */
 	if (image->shots) {
 		eznotify(vidx->sysopt, EN_PROC_CURRENT, 
@@ -2574,6 +4582,9 @@ static int video_snap_end(EZVID *vidx, EZIMG *image)
 	struct	ezntf	myntf;
 	char	status[128];
 
+	/* all shots must be on the canvas before saving */
+	video_pipe_flush(vidx);
+
 	if (vidx->dur_all && vidx->next) {	/* hasn't finished */
 		return 0;
 	}
@@ -2606,31 +4617,244 @@ static int video_snap_end(EZVID *vidx, EZIMG *image)
 
 	if (image->gdcanvas && (image->sysopt->flags & EZOP_INFO)) {
 		/* update the media information area */
-		video_media_on_canvas(vidx, image);
+		if (image->band_rows == NULL) {
+			video_media_on_canvas(vidx, image);
+		}
 		/* Insert as status line */
+		image_band_seek(image, image->grid_row - 1);
 		image_gdcanvas_print(image, -1, 0, status);
 	} else {
 		/* display the media information in console */
 		video_media_on_canvas(vidx, NULL);
 	}
-	if (image->gdcanvas) {
-		if (vidx->anchor) {
-			image_gdcanvas_save(image, vidx->anchor->filename);
-		} else {
-			image_gdcanvas_save(image, vidx->filename);
-		}
-#ifdef	HAVE_GDIMAGEGIFANIMBEGIN
-	} else if (image->gifx_fp) {
-		image_gif_anim_close(image, image->gifx_fp);
+	if (image->gdcanvas) {
+		if (vidx->anchor) {
+			image_gdcanvas_save(image, vidx->anchor->filename);
+		} else {
+			image_gdcanvas_save(image, vidx->filename);
+		}
+#ifdef	HAVE_GDIMAGEGIFANIMBEGIN
+	} else if (image->gifx_fp) {
+		image_gif_anim_close(image, image->gifx_fp);
+#endif
+	}
+
+	myntf.varg1 = vidx;
+	myntf.varg2 = image;
+	eznotify(vidx->sysopt, EN_PROC_SAVED, 0, 0, &myntf);
+	return 0;
+}
+
+/* scale the frame into the shot and put it onto the canvas, or save it
+ * as an individual image */
+static int video_snap_compose(EZVID *vidx, EZIMG *image, AVFrame *frame,
+		int idx, char *timestamp)
+{
+	int64_t	tmark, tenc;
+
+	tmark = av_gettime();
+	/* scale the frame into GD frame structure */
+	sws_scale(vidx->swsframe->context, 
+			(const uint8_t * const *) frame->data,
+			frame->linesize, 0, vidx->vidframe->height, 
+			vidx->swsframe->frame->data, 
+			vidx->swsframe->frame->linesize);
+	tmark = av_gettime() - tmark;
+	vidx->stat.t_scale += tmark;
+	/* measuring after the timing so the Lanczos is not counted */
+	if (vidx->refframe) {
+		video_scaler_bench(vidx, frame, idx, (int) tmark);
+	}
+	vidx->stat.shots++;
+	if ((image->sysopt->flags & EZOP_TIMEST) == 0) {
+		timestamp = NULL;
+	}
+
+	/* 20181018 the shot goes straight into its cell of the canvas. 
+	 * The GD frame is only used by individual shots */
+	tmark = av_gettime();
+	tenc  = image->stat->t_encode;
+	if (image->gdcanvas) {
+		image_gdcanvas_update(image, vidx->swsframe->frame, 
+				idx, timestamp);
+		/* the banded canvas could encode a band in the updating */
+		vidx->stat.t_compose += av_gettime() - tmark - 
+				(image->stat->t_encode - tenc);
+		return 0;
+	}
+
+	image_gdframe_update(image, vidx->swsframe->frame);
+	/* write the timestamp into the shot */
+	if (timestamp) {
+		image_gdframe_timestamp(image, image->gdframe, 0, 0, timestamp);
+	}
+	vidx->stat.t_compose += av_gettime() - tmark;
+
+#ifdef	HAVE_GDIMAGEGIFANIMBEGIN
+	if (image->gifx_fp) {
+		tmark = av_gettime();
+		image_gif_anim_add(image, image->gifx_fp, image->gifx_opt);
+		image->stat->t_encode += av_gettime() - tmark;
+		return 0;
+	}
+#endif
+	image_gdframe_save(image, vidx->filename, idx);
+	return 0;
+}
+
+/* start the compose stage. If the thread can't be created, the shots 
+ * would be composed in the decoding thread as usual */
+static int video_pipe_open(EZVID *vidx, EZIMG *image)
+{
+#ifdef	EZ_PIPELINE
+	EZPIPE	*ppl;
+
+	if (vidx->pipeline) {
+		return 0;
+	}
+	if ((ppl = smm_alloc(sizeof(EZPIPE))) == NULL) {
+		return -1;
+	}
+	ppl->vidx  = vidx;
+	ppl->image = image;
+	pthread_mutex_init(&ppl->lock, NULL);
+	pthread_cond_init(&ppl->cond, NULL);
+	if (pthread_create(&ppl->tid, NULL, video_pipe_worker, ppl)) {
+		CDB_ERROR(("video_pipe_open: failed to create the thread\n"));
+		pthread_cond_destroy(&ppl->cond);
+		pthread_mutex_destroy(&ppl->lock);
+		smm_free(ppl);
+		return -1;
+	}
+	vidx->pipeline = ppl;
+	return 0;
+#else
+	(void) vidx; (void) image;
+	return -1;
+#endif
+}
+
+/* queue a reference of the frame to the compose stage. It blocks while
+ * the queue is full. Return -1 if the frame wasn't queued */
+static int video_pipe_push(EZVID *vidx, AVFrame *frame, int idx, char *ts)
+{
+#ifdef	EZ_PIPELINE
+	EZPIPE	*ppl = vidx->pipeline;
+	EZSHOT	*shot;
+	AVFrame	*ref;
+
+	if (ppl == NULL) {
+		return -1;
+	}
+	if ((ref = av_frame_alloc()) == NULL) {
+		return -1;
+	}
+	if (av_frame_ref(ref, frame) < 0) {
+		av_frame_free(&ref);
+		return -1;
+	}
+
+	pthread_mutex_lock(&ppl->lock);
+	while (ppl->num >= EZ_PIPE_DEPTH) {	/* backpressure */
+		pthread_cond_wait(&ppl->cond, &ppl->lock);
+	}
+	shot = &ppl->shot[(ppl->head + ppl->num) % EZ_PIPE_DEPTH];
+	shot->frame = ref;
+	shot->idx   = idx;
+	strncpy(shot->timestamp, ts, sizeof(shot->timestamp) - 1);
+	shot->timestamp[sizeof(shot->timestamp) - 1] = 0;
+	ppl->num++;
+	pthread_cond_broadcast(&ppl->cond);
+	pthread_mutex_unlock(&ppl->lock);
+	return 0;
+#else
+	(void) vidx; (void) frame; (void) idx; (void) ts;
+	return -1;
+#endif
+}
+
+/* wait until every queued shot has been composed */
+static int video_pipe_flush(EZVID *vidx)
+{
+#ifdef	EZ_PIPELINE
+	EZPIPE	*ppl = vidx->pipeline;
+
+	if (ppl == NULL) {
+		return 0;
+	}
+	pthread_mutex_lock(&ppl->lock);
+	while (ppl->num || ppl->busy) {
+		pthread_cond_wait(&ppl->cond, &ppl->lock);
+	}
+	pthread_mutex_unlock(&ppl->lock);
+#else
+	(void) vidx;
 #endif
+	return 0;
+}
+
+/* flush the queue and stop the compose stage */
+static int video_pipe_close(EZVID *vidx)
+{
+#ifdef	EZ_PIPELINE
+	EZPIPE	*ppl = vidx->pipeline;
+
+	if (ppl == NULL) {
+		return 0;
 	}
+	video_pipe_flush(vidx);
 
-	myntf.varg1 = vidx;
-	myntf.varg2 = image;
-	eznotify(vidx->sysopt, EN_PROC_SAVED, 0, 0, &myntf);
+	pthread_mutex_lock(&ppl->lock);
+	ppl->quit = 1;
+	pthread_cond_broadcast(&ppl->cond);
+	pthread_mutex_unlock(&ppl->lock);
+	pthread_join(ppl->tid, NULL);
+
+	pthread_cond_destroy(&ppl->cond);
+	pthread_mutex_destroy(&ppl->lock);
+	smm_free(ppl);
+	vidx->pipeline = NULL;
+#else
+	(void) vidx;
+#endif
 	return 0;
 }
 
+#ifdef	EZ_PIPELINE
+static void *video_pipe_worker(void *arg)
+{
+	EZPIPE	*ppl = arg;
+	EZSHOT	shot;
+
+	pthread_mutex_lock(&ppl->lock);
+	while (1) {
+		if (ppl->num == 0) {
+			if (ppl->quit) {
+				break;
+			}
+			pthread_cond_wait(&ppl->cond, &ppl->lock);
+			continue;
+		}
+		shot = ppl->shot[ppl->head];
+		ppl->head = (ppl->head + 1) % EZ_PIPE_DEPTH;
+		ppl->num--;
+		ppl->busy = 1;
+		pthread_cond_broadcast(&ppl->cond);
+		pthread_mutex_unlock(&ppl->lock);
+
+		video_snap_compose(ppl->vidx, ppl->image, shot.frame, 
+				shot.idx, shot.timestamp);
+		av_frame_free(&shot.frame);
+
+		pthread_mutex_lock(&ppl->lock);
+		ppl->busy = 0;
+		pthread_cond_broadcast(&ppl->cond);
+	}
+	pthread_mutex_unlock(&ppl->lock);
+	return NULL;
+}
+#endif
+
 static EZFRM *video_frame_alloc(int pixfmt, int width, int height)
 {
 	EZFRM	*ezfrm;
@@ -2732,16 +4956,27 @@ static int video_frame_update(EZVID *vidx)
 		return 0;
 	}
 	
-#ifdef	HAVE_AV_IMAGE_COPY
+#if	defined(EZ_FRAME_REFCOUNT)
+	/* 20181018 swap the reference of the frame buffer instead of 
+	 * copying the whole picture. The decoder would never reuse the 
+	 * buffer while it's still referred by the picframe */
+	av_frame_unref(vidx->picframe->frame);
+	if (av_frame_ref(vidx->picframe->frame, vidx->vidframe->frame) < 0) {
+		vidx->picframe->rf_dts = -1;
+		return 0;
+	}
+#elif	defined(HAVE_AV_IMAGE_COPY)
 	av_image_copy(vidx->picframe->frame->data, 
 			vidx->picframe->frame->linesize, 
 			(const uint8_t **) vidx->vidframe->frame->data,
 			vidx->vidframe->frame->linesize,
-			vidx->codecx->pix_fmt, vidx->width, vidx->height);
+			vidx->codecx->pix_fmt, 
+			vidx->vidframe->width, vidx->vidframe->height);
 #else
 	av_picture_copy((AVPicture *) vidx->picframe->frame, 
 			(AVPicture *) vidx->vidframe->frame, 
-			vidx->codecx->pix_fmt, vidx->width, vidx->height);
+			vidx->codecx->pix_fmt, 
+			vidx->vidframe->width, vidx->vidframe->height);
 #endif
 	vidx->picframe->frame->pict_type = vidx->vidframe->frame->pict_type;
 	
@@ -2812,19 +5047,19 @@ static int video_frame_save_jpeg(EZVID *vidx, EZFRM *ezfrm)
 	/* convert image from YUV to RGB */
 	sws_scale(vidx->capframe->context, 
 			(const uint8_t * const *) ezfrm->frame->data,
-			ezfrm->frame->linesize, 0, vidx->height, 
+			ezfrm->frame->linesize, 0, vidx->capframe->height, 
 			vidx->capframe->frame->data, 
 			vidx->capframe->frame->linesize);
 
 	/* convert image from FFMPEG to GD device */
 	src = vidx->capframe->frame->data[0];
-	for (y = 0; y < vidx->height; y++) {
-		for (x = 0; x < vidx->width * 3; x += 3) {
+	for (y = 0; y < vidx->capframe->height; y++) {
+		for (x = 0; x < vidx->capframe->width * 3; x += 3) {
 			gdImageSetPixel(vidx->capgdimg, x / 3, y,
 					gdImageColorResolve(vidx->capgdimg,
 						src[x], src[x+1], src[x+2]));
 		}
-		src += vidx->width * 3;
+		src += vidx->capframe->width * 3;
 	}
 
 	/* write the timestamp into the shot */
@@ -2896,7 +5131,7 @@ static int video_frame_save_rgb(EZVID *vidx, EZFRM *ezfrm)
 	/* convert image from YUV to RGB */
 	sws_scale(vidx->capframe->context, 
 			(const uint8_t * const *) ezfrm->frame->data,
-			ezfrm->frame->linesize, 0, vidx->height, 
+			ezfrm->frame->linesize, 0, vidx->capframe->height, 
 			vidx->capframe->frame->data, 
 			vidx->capframe->frame->linesize);
 
@@ -2916,63 +5151,130 @@ static int video_frame_save_rgb(EZVID *vidx, EZFRM *ezfrm)
 }
 #endif	/* CFG_SNAPSHOT_RGB */
 
-static int64_t video_decode_next(EZVID *vidx, AVPacket *packet)
+/* 20181017 decode one packet without loading more packets. It returns 1 
+ * if a picture was decoded or 0 if the decoder wants more packets. 
+ * The packet would be freed anyway */
+static int video_decode_packet(EZVID *vidx, AVPacket *packet)
 {
-	int64_t	tmp;
 	EZFRM	*ezfrm = vidx->vidframe;
 	int	got_pict = 0;
 
-	ezfrm->rf_pos  = packet->pos;
-	ezfrm->rf_size = 0;
-	ezfrm->rf_pac  = 0;
-
-	do {
+	if (EN_EVENT_WANT(vidx->sysopt, EN_PACKET_RECV)) {
 		eznotify(vidx->sysopt, EN_PACKET_RECV, 0, 0, packet);
-		ezfrm->rf_size += packet->size;
-		ezfrm->rf_pac++;
-		
-		/* 20150115:according to the recent avcodec.h, the DTS of 
-		 * a frame should keep up with the received packets */
-		ezfrm->rf_dts = video_packet_timestamp(packet);
+	}
+	ezfrm->rf_size += packet->size;
+	ezfrm->rf_pac++;
+	vidx->stat.decoded++;
+	
+	/* 20150115:according to the recent avcodec.h, the DTS of 
+	 * a frame should keep up with the received packets */
+	ezfrm->rf_dts = video_packet_timestamp(packet);
+
+	video_decode_skip(vidx, (vidx->skipto > 0) && 
+			(ezfrm->rf_dts < vidx->skipto));
 
 #ifdef	HAVE_AVCODEC_RECEIVE_FRAME
-		avcodec_send_packet(vidx->codecx, packet);
-		if (avcodec_receive_frame(vidx->codecx, ezfrm->frame) >= 0) {
-			got_pict = 1;
-		}
+	avcodec_send_packet(vidx->codecx, packet);
+	if (avcodec_receive_frame(vidx->codecx, ezfrm->frame) >= 0) {
+		got_pict = 1;
+	}
 #else
-		avcodec_decode_video2(vidx->codecx, 
-				ezfrm->frame, &got_pict, packet);
+	avcodec_decode_video2(vidx->codecx, ezfrm->frame, &got_pict, packet);
 #endif
-		
-		ezfrm->context = packet;
+	
+	ezfrm->context = packet;
+	if (EN_EVENT_WANT(vidx->sysopt, EN_FRAME_DONE)) {
 		eznotify(vidx->sysopt, EN_FRAME_DONE, 0, got_pict, ezfrm);
-		video_free_packet(packet);
+	}
+	video_free_packet(packet);
+	if (!got_pict) {
+		return 0;
+	}
+	vidx->stat.frames++;
 
-		/* 20150108: If a I-Frame has been successfully decoded,
-		 * the following frames can be stored in the dual frame
-		 * buffer in turn. The following decoding is named as
-		 * frame group. The I-Frame is the beginner of the group */
-		if (got_pict) {
-			/* the reference PTS from the decoder */ 
+	/* 20181013 the frame threading delays the output of the decoder 
+	 * so the DTS of the current packet is not the DTS of the frame */
+	if ((vidx->codecx->active_thread_type & FF_THREAD_FRAME) &&
+			(ezfrm->frame->pkt_dts != AV_NOPTS_VALUE)) {
+		ezfrm->rf_dts = ezfrm->frame->pkt_dts;
+	}
+	/* the reference PTS from the decoder */ 
 #if	defined(HAVE_AVFRAME_BEST_ETS)
-			ezfrm->rf_pts = ezfrm->frame->best_effort_timestamp;
+	ezfrm->rf_pts = ezfrm->frame->best_effort_timestamp;
 #elif	defined(HAVE_AVFRAME_PTS)
-			ezfrm->rf_pts = ezfrm->frame->pts;
+	ezfrm->rf_pts = ezfrm->frame->pts;
 #elif	defined(HAVE_AVFRAME_PKT_PTS)
-			ezfrm->rf_pts = ezfrm->frame->pkt_pts;
+	ezfrm->rf_pts = ezfrm->frame->pkt_pts;
 #else
-			ezfrm->rf_pts = AV_NOPTS_VALUE;
+	ezfrm->rf_pts = AV_NOPTS_VALUE;
 #endif
-			if (ezfrm->rf_pts <= 0) {
-				ezfrm->rf_pts = ezfrm->rf_dts;
-			}
+	if (ezfrm->rf_pts <= 0) {
+		ezfrm->rf_pts = ezfrm->rf_dts;
+	}
 
-			/* Update the flag when a key frame was decoded */
-			if (ezfrm->frame->key_frame) {
-				ezfrm->keyflag = 1;
-			}
-			//printf("video_decode_next: %lld %d\n", ezfrm->rf_dts, ezfrm->keyflag);
+	/* Update the flag when a key frame was decoded */
+	if (ezfrm->frame->key_frame) {
+		ezfrm->keyflag = 1;
+	}
+	//printf("video_decode_packet: %lld %d\n", ezfrm->rf_dts, ezfrm->keyflag);
+	return 1;
+}
+
+/* 20181017 The frames before the last GOP of the snap point were decoded
+ * only to keep the decoder going, so the non-reference frames, the loop 
+ * filter and the IDCT of the B-frames could be skipped. The damages in the
+ * reference frames would be cleared by the next key frame. The full 
+ * decoding is restored in the last GOP */
+static int video_decode_skip(EZVID *vidx, int skip)
+{
+	if (vidx->skipping == skip) {
+		return skip;
+	}
+	vidx->skipping = skip;
+	if (skip) {
+		vidx->codecx->skip_frame       = AVDISCARD_NONREF;
+		vidx->codecx->skip_loop_filter = AVDISCARD_ALL;
+		vidx->codecx->skip_idct        = AVDISCARD_BIDIR;
+	} else {
+		vidx->codecx->skip_frame       = AVDISCARD_DEFAULT;
+		vidx->codecx->skip_loop_filter = AVDISCARD_DEFAULT;
+		vidx->codecx->skip_idct        = AVDISCARD_DEFAULT;
+	}
+	CDB_MODL(("video_decode_skip: %d\n", skip));
+	return skip;
+}
+
+/* find the DTS where the last GOP before the snap point starts. The key 
+ * frame index tells it exactly, otherwise it's estimated by the keygap
+ * with some margin. Return 0 if it can't be decided */
+static int64_t video_skip_point(EZVID *vidx, int64_t dtsto)
+{
+	EZKEY	*key;
+
+	if ((key = video_keyidx_find(vidx, dtsto)) != NULL) {
+		return key->dts;
+	}
+	if (vidx->keygap > 0) {
+		return dtsto - vidx->keygap * 2;
+	}
+	return 0;
+}
+
+static int64_t video_decode_next(EZVID *vidx, AVPacket *packet)
+{
+	int64_t	tmp;
+	EZFRM	*ezfrm = vidx->vidframe;
+
+	ezfrm->rf_pos  = packet->pos;
+	ezfrm->rf_size = 0;
+	ezfrm->rf_pac  = 0;
+
+	do {
+		/* 20150108: If a I-Frame has been successfully decoded,
+		 * the following frames can be stored in the dual frame
+		 * buffer in turn. The following decoding is named as
+		 * frame group. The I-Frame is the beginner of the group */
+		if (video_decode_packet(vidx, packet)) {
 			return ezfrm->rf_dts;	/* succeeded */
 		}
 	} while (video_load_packet(vidx, packet) >= 0);
@@ -2984,20 +5286,49 @@ static int64_t video_decode_next(EZVID *vidx, AVPacket *packet)
 	return tmp; 	/* this function never failed */
 }
 
+/* 20181017 feed the buffered packets in the ring to the decoder until a 
+ * frame reached the 'dtsto'. Frames before the 'dtsto' were kept in the
+ * dual frame buffer like video_decode_to(). It returns the DTS of the 
+ * frame, or -1 if it ran out of the buffered packets */
+static int64_t video_decode_ring(EZVID *vidx, EZRING *ring, int64_t dtsto)
+{
+	EZFRM	*ezfrm = vidx->vidframe;
+
+	while (ring->dec < ring->num) {
+		if (ring->fresh) {
+			ezfrm->rf_size = ezfrm->rf_pac = ring->fresh = 0;
+		}
+		if (ezfrm->rf_pac == 0) {
+			ezfrm->rf_pos = ring->pkt[ring->dec].pos;
+		}
+		if (!video_decode_packet(vidx, &ring->pkt[ring->dec++])) {
+			continue;
+		}
+		ring->fresh = 1;
+		if (ezfrm->rf_dts >= dtsto) {
+			return ezfrm->rf_dts;
+		}
+		video_frame_update(vidx);
+	}
+	return -1;
+}
+
 static int64_t video_decode_to(EZVID *vidx, AVPacket *packet, int64_t dtsto)
 {
 	int64_t	dts;
 
 	//printf("video_decode_to: decode to %" PRId64 ".\n", dtsto);
+	vidx->skipto = video_skip_point(vidx, dtsto);
 	do {
 		if ((dts = video_decode_next(vidx, packet)) < 0) {
 			break;
 		}
 		if (dts >= dtsto) {
-			return dts;
+			break;
 		}
 		video_frame_update(vidx);
 	} while (video_load_packet(vidx, packet) >= 0);
+	vidx->skipto = 0;
 	/* 20130808 Return the closest frame */
 	return dts;
 }
@@ -3070,7 +5401,9 @@ static int64_t video_decode_safe(EZVID *vidx, AVPacket *packet, int64_t dtsto)
 
 		/* working on OTF mode as default */
 		if (vidx->ses_flags & EZOP_DECODE_OTF) {
+			vidx->skipto = video_skip_point(vidx, dtsto);
 			video_decode_next(vidx, packet);
+			vidx->skipto = 0;
 			video_frame_update(vidx);
 		} else {
 			video_free_packet(packet);
@@ -3140,12 +5473,19 @@ static int64_t video_decode_to(EZVID *vidx, AVPacket *packet, int64_t dtsto)
 static int video_seeking(EZVID *vidx, int64_t dts)
 {
 	//int64_t	mindts;
-
-	//av_seek_frame(vidx->formatx, vidx->vsidx, dts, AVSEEK_FLAG_BACKWARD);
-	//mindts = dts - video_ms_to_dts(vidx, 60000);
-	avformat_seek_file(vidx->formatx, vidx->vsidx, 
-			//mindts, dts, INT64_MAX, AVSEEK_FLAG_FRAME);
-			0, dts, INT64_MAX, AVSEEK_FLAG_BACKWARD);
+	int64_t	tmark = av_gettime();
+
+	/* 20181016 seek to the key frame in the index directly */
+	if (video_keyidx_seek(vidx, video_keyidx_find(vidx, dts)) < 0) {
+		//av_seek_frame(vidx->formatx, vidx->vsidx, dts, 
+		//		AVSEEK_FLAG_BACKWARD);
+		//mindts = dts - video_ms_to_dts(vidx, 60000);
+		avformat_seek_file(vidx->formatx, vidx->vsidx, 
+				//mindts, dts, INT64_MAX, AVSEEK_FLAG_FRAME);
+				0, dts, INT64_MAX, AVSEEK_FLAG_BACKWARD);
+	}
+	vidx->stat.seeks++;
+	vidx->stat.t_seek += av_gettime() - tmark;
 	avcodec_flush_buffers(vidx->codecx);
 	video_keyframe_credit(vidx, -1);
 	/* reset the key frame decoding flag */
@@ -3314,20 +5654,21 @@ static int64_t video_packet_timestamp(AVPacket *packet)
 	return dts;
 }
 
+/* 20181012 the last timestamp moved into EZVID so it won't be messed up
+ * when files were processed concurrently */
 static int video_timing(EZVID *vidx, int type)
 {
-	static	SMM_TIME	last;
 	int	acc;
 
 	if (type == EZ_PTS_RESET) {
-		smm_time_get_epoch(&last);
+		smm_time_get_epoch(&vidx->ptslast);
 		memset(vidx->pts, 0, sizeof(vidx->pts));
 		vidx->pidx = 0;
 		return 0;
 	}
 
-	acc = smm_time_diff(&last);
-	smm_time_get_epoch(&last);
+	acc = smm_time_diff(&vidx->ptslast);
+	smm_time_get_epoch(&vidx->ptslast);
 	if (type == EZ_PTS_CLEAR) {
 		return acc;
 	}
@@ -3460,6 +5801,7 @@ static EZIMG *image_allocate(EZVID *vidx, EZTIME rt_during, int *errcode)
 	}
 	
 	ezopt = image->sysopt = vidx->sysopt;
+	image->stat = &vidx->stat;
 	src_width = vidx->width;
 	ar_height = vidx->ar_height;	/* 20120720 Apply the AR correction */
 
@@ -3662,8 +6004,11 @@ static EZIMG *image_allocate(EZVID *vidx, EZTIME rt_during, int *errcode)
 	if ((image->grid_col > 0) && !image_cal_gif_animix(image->sysopt)) {
 		/* only create the GD device for handling the canvas 
 		 * when canvas is required */
-		image->gdcanvas = gdImageCreateTrueColor(image->canvas_width,
-				image->canvas_height);
+		if (image_band_create(image) == NULL) {
+			image->gdcanvas = gdImageCreateTrueColor(
+					image->canvas_width,
+					image->canvas_height);
+		}
 		if (image->gdcanvas == NULL) {
 			image_free(image);
 			uperror(errcode, EZ_ERR_LOWMEM);
@@ -3710,6 +6055,12 @@ static EZIMG *image_allocate(EZVID *vidx, EZTIME rt_during, int *errcode)
 			ezopt->its_color[0], ezopt->its_color[1],
 			ezopt->its_color[2], ezopt->its_color[3]);
 
+	/* pick up the glyphs of the timestamp rendered in advance. The 
+	 * image of estimating the duration has no errcode and takes no shot */
+	if (errcode && (ezopt->flags & EZOP_TIMEST)) {
+		image->atlas = image_atlas_find(image);
+	}
+
 	uperror(errcode, EZ_ERR_NONE);
 
 	/* FIXME: this is really a bad idea that hacking the function by the 
@@ -3723,6 +6074,7 @@ static EZIMG *image_allocate(EZVID *vidx, EZTIME rt_during, int *errcode)
 
 static int image_free(EZIMG *image)
 {
+	image_band_free(image);
 	if (image->gdcanvas) {
 		gdImageDestroy(image->gdcanvas);
 	}
@@ -3820,26 +6172,37 @@ static int image_font_test(EZIMG *image, char *filename)
 }
 
 /* This function is used to fill the GD image device with the content of 
- * the RGB frame buffer. It will flush the last image */
+ * the RGB frame buffer. It will flush the last image.
+ * The gdframe is always a true color image so the RGB24 pixels can be
+ * packed straight into its tpixels[] rows. gdImageColorResolve() and 
+ * gdImageSetPixel() were called for every pixel before, which were the
+ * hot spot when taking large shots */
 static int image_gdframe_update(EZIMG *image, AVFrame *frame)
 {
 	unsigned char	*src;
+	int	*dst;
 	int	x, y;
 
+	if (!gdImageTrueColor(image->gdframe)) {
+		return EZ_ERR_FORMAT;
+	}
+
 	src = frame->data[0];
 	for (y = 0; y < image->dst_height; y++) {
-		for (x = 0; x < image->dst_width * 3; x += 3) {
-			gdImageSetPixel(image->gdframe, x / 3, y,
-					gdImageColorResolve(image->gdframe,
-						src[x], src[x+1], src[x+2]));
+		dst = image->gdframe->tpixels[y];
+		for (x = 0; x < image->dst_width; x++, src += 3) {
+			dst[x] = gdTrueColor(src[0], src[1], src[2]);
 		}
-		src += image->dst_width * 3;
+		src += frame->linesize[0] - image->dst_width * 3;
 	}
 	return EZ_ERR_NONE;
 }
 
-/* This function is used to write a timestamp into the screen shot */
-static int image_gdframe_timestamp(EZIMG *image, char *timestamp)
+/* This function is used to write a timestamp into the screen shot. 
+ * The screen shot is at (ox,oy) of the 'dst', which could be the GD frame
+ * or the canvas */
+static int image_gdframe_timestamp(EZIMG *image, gdImage *dst, 
+		int ox, int oy, char *timestamp)
 {
 	int	x, y, ts_width, ts_height;
 	
@@ -3891,13 +6254,15 @@ static int image_gdframe_timestamp(EZIMG *image, char *timestamp)
 		y = image->dst_height - ts_height - EZ_TEXT_INSET_GAP;
 		break;
 	}
+	x += ox;
+	y += oy;
 	if (image->sysopt->ins_shadow) {
-		image_gdframe_puts(image, image->sysopt->ins_size,
+		image_gdframe_puts(image, dst, image->sysopt->ins_size,
 				x + image->sysopt->ins_shadow,
 				y + image->sysopt->ins_shadow,
 				image->color_inshadow, timestamp);
 	}
-	image_gdframe_puts(image, image->sysopt->ins_size,
+	image_gdframe_puts(image, dst, image->sysopt->ins_size,
 			x, y, image->color_inset, timestamp);
 	return EZ_ERR_NONE;
 }
@@ -3908,33 +6273,28 @@ static int image_gdframe_save(EZIMG *image, char *filename, int idx)
 {
 	FILE	*fout;
 
+	int	rc;
+
 	if ((fout = image_create_file(image, filename, idx)) == NULL) {
 		return EZ_ERR_FILE;
 	}
-
-	switch (EZ_IMG_FMT_GET(image->sysopt->img_format)) {
-	case EZ_IMG_FMT_PNG:
-		gdImagePng(image->gdframe, fout);
-		break;
-	case EZ_IMG_FMT_GIF:
-	case EZ_IMG_FMT_GIFA:
-		gdImageGif(image->gdframe, fout);
-		break;
-	default:
-		gdImageJpeg(image->gdframe, fout, 
-				EZ_IMG_PARAM_GET(image->sysopt->img_format));
-		break;
-	}
+	rc = image_gd_output(image, image->gdframe, fout);
 	fclose(fout);
-	return EZ_ERR_NONE;
+	return rc;
 }
 
 static int image_gdframe_strlen(EZIMG *image, int fsize, char *s)
 {
+	EZATLAS	*atlas = image->atlas;
 	gdFont	*font;
 	int	brect[8];
 
 	fsize = image_fontsize(fsize, image->dst_width);
+	if (atlas && (atlas->fsize == fsize) && 
+			!image_atlas_measure(atlas, s, brect)) {
+		return EZ_MK_WORD(brect[2] - brect[0] - 2, 
+				brect[3] - brect[1] - 2);
+	}
 	if (image->sysopt->ins_font == NULL) {
 		font = image_fontset(fsize);
 	} else if (gdImageStringFT(NULL, brect,	0, image->sysopt->ins_font, 
@@ -3946,7 +6306,7 @@ static int image_gdframe_strlen(EZIMG *image, int fsize, char *s)
 	return EZ_MK_WORD(font->w * strlen(s), font->h);
 }
 
-static int image_gdframe_puts(EZIMG *image, int fsize, 
+static int image_gdframe_puts(EZIMG *image, gdImage *dst, int fsize, 
 		int x, int y, int c, char *s)
 {
 	int	brect[8];
@@ -3954,15 +6314,19 @@ static int image_gdframe_puts(EZIMG *image, int fsize,
 	CDB_FUNC(("image_gdframe_puts(%dx%dx%d): %s (0x%x)\n", 
 				x, y, fsize, s, c));
 	fsize = image_fontsize(fsize, image->dst_width);
+	if (image->atlas && (((EZATLAS *) image->atlas)->fsize == fsize) &&
+			!image_atlas_puts(image, dst, x, y, c, s)) {
+		return 0;
+	}
 	if (image->sysopt->ins_font == NULL) {
-		gdImageString(image->gdframe, image_fontset(fsize),
+		gdImageString(dst, image_fontset(fsize),
 				x, y, (unsigned char *) s, c);
 	} else if (gdImageStringFT(NULL, brect, 0, image->sysopt->ins_font,
 				(double) fsize, 0, 0, 0, s)) {
-		gdImageString(image->gdframe, image_fontset(fsize),
+		gdImageString(dst, image_fontset(fsize),
 				x, y, (unsigned char *) s, c);
 	} else {
-		gdImageStringFT(image->gdframe, brect, c, 
+		gdImageStringFT(dst, brect, c, 
 				image->sysopt->ins_font, 
 				(double) fsize, 0, 
 				x - brect[6], y - brect[7], s);
@@ -3970,10 +6334,246 @@ static int image_gdframe_puts(EZIMG *image, int fsize,
 	return 0;
 }
 
+/* 20181018 This function renders the glyph atlases of the timestamp by
+ * the FreeType font once in a run. It must be called before any worker
+ * thread starts. The automatic font size depends on the width of shots 
+ * so every size it could choose gets an atlas. The atlas only stores the 
+ * coverage so it works with any inset colors. The bitmap font of GD is 
+ * fast enough so no atlas */
+int ezopt_atlas_setup(EZOPT *ezopt)
+{
+	static	const	int	autosize[] = { EZ_FONT_TINY, EZ_FONT_SMALL, 
+		EZ_FONT_MEDIUM, EZ_FONT_LARGE };
+	EZATLAS	*atlas;
+	int	i;
+
+	ezopt_atlas_free(ezopt);
+	if ((ezopt->ins_font == NULL) || !(ezopt->flags & EZOP_TIMEST)) {
+		return EZ_ERR_NONE;
+	}
+	if (ezopt->ins_size != EZ_FONT_AUTO) {
+		ezopt->atlas = image_atlas_create(ezopt->ins_font, 
+				ezopt->ins_size);
+		return EZ_ERR_NONE;
+	}
+	for (i = 0; i < (int)(sizeof(autosize)/sizeof(int)); i++) {
+		atlas = image_atlas_create(ezopt->ins_font, autosize[i]);
+		if (atlas) {
+			atlas->next = ezopt->atlas;
+			ezopt->atlas = atlas;
+		}
+	}
+	return EZ_ERR_NONE;
+}
+
+int ezopt_atlas_free(EZOPT *ezopt)
+{
+	EZATLAS	*atlas;
+
+	while ((atlas = ezopt->atlas) != NULL) {
+		ezopt->atlas = atlas->next;
+		image_atlas_free(atlas);
+	}
+	return EZ_ERR_NONE;
+}
+
+static EZATLAS *image_atlas_create(char *font, int fsize)
+{
+	EZATLAS	*atlas;
+	int	i;
+
+	if ((atlas = smm_alloc(sizeof(EZATLAS) + strlen(font))) == NULL) {
+		return NULL;
+	}
+	strcpy(atlas->font, font);
+	atlas->fsize = fsize;
+	for (i = 0; i < (int) sizeof(EZ_GLYPH_SET) - 1; i++) {
+		if (image_atlas_render(font, &atlas->glyph[i], fsize, 
+					EZ_GLYPH_SET[i]) < 0) {
+			/* fall back to the FreeType of GD */
+			image_atlas_free(atlas);
+			return NULL;
+		}
+	}
+	CDB_DEBUG(("image_atlas_create: %d glyphs in size %d\n", i, fsize));
+	return atlas;
+}
+
+static int image_atlas_free(EZATLAS *atlas)
+{
+	int	i;
+
+	for (i = 0; i < (int) sizeof(EZ_GLYPH_SET) - 1; i++) {
+		if (atlas->glyph[i].alpha) {
+			smm_free(atlas->glyph[i].alpha);
+		}
+	}
+	smm_free(atlas);
+	return EZ_ERR_NONE;
+}
+
+/* find the atlas of the inset font in the size of this image. The font 
+ * could have been changed after the atlases were made, by the GUI for 
+ * example, then the FreeType of GD is used instead */
+static EZATLAS *image_atlas_find(EZIMG *image)
+{
+	EZATLAS	*atlas;
+	int	fsize;
+
+	if (image->sysopt->ins_font == NULL) {
+		return NULL;
+	}
+	fsize = image_fontsize(image->sysopt->ins_size, image->dst_width);
+	for (atlas = image->sysopt->atlas; atlas; atlas = atlas->next) {
+		if ((atlas->fsize == fsize) && 
+				!strcmp(atlas->font, image->sysopt->ins_font)) {
+			return atlas;
+		}
+	}
+	return NULL;
+}
+
+/* The glyph is rendered in white on black so the green channel is the 
+ * coverage. The ink box is enlarged by one pixel in each side to keep 
+ * the anti-aliasing edge. The advance is the difference between the ink
+ * boxes of the single and the double characters */
+static int image_atlas_render(char *font, EZGLYPH *glyph, int fsize, 
+		int ch)
+{
+	gdImage	*gdimg;
+	char	s[4];
+	int	brect[8], dbrect[8], x, y;
+
+	s[0] = s[1] = (char) ch;
+	s[2] = 0;
+	if (gdImageStringFT(NULL, dbrect, 0, font,
+				(double) fsize, 0, 0, 0, s)) {
+		return -1;
+	}
+	s[1] = 0;
+	if (gdImageStringFT(NULL, brect, 0, font,
+				(double) fsize, 0, 0, 0, s)) {
+		return -1;
+	}
+
+	glyph->left    = brect[0] - 1;
+	glyph->top     = brect[7] - 1;
+	glyph->width   = brect[2] - brect[0] + 3;
+	glyph->height  = brect[1] - brect[7] + 3;
+	glyph->advance = dbrect[2] - brect[2];
+	
+	gdimg = gdImageCreateTrueColor(glyph->width, glyph->height);
+	if (gdimg == NULL) {
+		return -1;
+	}
+	glyph->alpha = smm_alloc(glyph->width * glyph->height);
+	if (glyph->alpha == NULL) {
+		gdImageDestroy(gdimg);
+		return -1;
+	}
+	gdImageStringFT(gdimg, brect, gdTrueColor(255, 255, 255),
+			font, (double) fsize, 0, 
+			-glyph->left, -glyph->top, s);
+	for (y = 0; y < glyph->height; y++) {
+		for (x = 0; x < glyph->width; x++) {
+			glyph->alpha[y * glyph->width + x] = (unsigned char)
+				gdTrueColorGetGreen(gdimg->tpixels[y][x]);
+		}
+	}
+	gdImageDestroy(gdimg);
+	return 0;
+}
+
+/* This function calculates the ink box of the string, which include the 
+ * one pixel margin of the glyphs. The box is {left, top, right, bottom}
+ * to the first pen position and the baseline. It returns -1 if any 
+ * character is not in the atlas */
+static int image_atlas_measure(EZATLAS *atlas, char *s, int *box)
+{
+	EZGLYPH	*glyph;
+	char	*p;
+	int	pen;
+
+	if (*s == 0) {
+		return -1;
+	}
+	box[0] = box[1] = 0x7fff;
+	box[2] = box[3] = -0x7fff;
+	for (pen = 0; *s; s++) {
+		if ((p = strchr(EZ_GLYPH_SET, *s)) == NULL) {
+			return -1;
+		}
+		glyph = &atlas->glyph[p - EZ_GLYPH_SET];
+		box[0] = FFMIN(box[0], pen + glyph->left);
+		box[1] = FFMIN(box[1], glyph->top);
+		box[2] = FFMAX(box[2], pen + glyph->left + glyph->width);
+		box[3] = FFMAX(box[3], glyph->top + glyph->height);
+		pen += glyph->advance;
+	}
+	return 0;
+}
+
+/* This function blends the glyphs into the truecolor image 'dst' so the
+ * ink box of the string is at (x,y), same as image_gdframe_puts(). The 
+ * clipping rectangle of the 'dst' is honored */
+static int image_atlas_puts(EZIMG *image, gdImage *dst, int x, int y, 
+		int c, char *s)
+{
+	EZATLAS	*atlas = image->atlas;
+	EZGLYPH	*glyph;
+	unsigned char	*alpha;
+	int	box[4], *row, pen, gx, gy, dx, dy, a, k, d;
+
+	if (!gdImageTrueColor(dst) || image_atlas_measure(atlas, s, box)) {
+		return -1;
+	}
+	/* the opacity of the color: GD alpha 0 is opaque and 127 is clear */
+	k = gdAlphaMax - gdTrueColorGetAlpha(c);
+	x -= box[0] + 1;
+	y -= box[1] + 1;
+	for (pen = x; *s; s++) {
+		glyph = &atlas->glyph[strchr(EZ_GLYPH_SET, *s) - EZ_GLYPH_SET];
+		for (gy = 0; gy < glyph->height; gy++) {
+			dy = y + glyph->top + gy;
+			if ((dy < dst->cy1) || (dy > dst->cy2)) {
+				continue;
+			}
+			row = dst->tpixels[dy];
+			alpha = glyph->alpha + gy * glyph->width;
+			for (gx = 0; gx < glyph->width; gx++) {
+				dx = pen + glyph->left + gx;
+				if ((dx < dst->cx1) || (dx > dst->cx2) || 
+						(alpha[gx] == 0)) {
+					continue;
+				}
+				a = alpha[gx] * k / gdAlphaMax;
+				d = row[dx];
+				row[dx] = gdTrueColorAlpha(
+					(gdTrueColorGetRed(c) * a + 
+					 gdTrueColorGetRed(d) * (255 - a)) / 255,
+					(gdTrueColorGetGreen(c) * a + 
+					 gdTrueColorGetGreen(d) * (255 - a)) / 255,
+					(gdTrueColorGetBlue(c) * a + 
+					 gdTrueColorGetBlue(d) * (255 - a)) / 255,
+					gdTrueColorGetAlpha(d));
+			}
+		}
+		pen += glyph->advance;
+	}
+	return 0;
+}
+
 /* This function is used to save the whole canvas */
 static int image_gdcanvas_save(EZIMG *image, char *filename)
 {
 	FILE	*fout;
+	int	rc;
+
+	/* the banded canvas has been streaming into the file. The encoding
+	 * is timed inside by bands */
+	if (image->band_rows) {
+		return image_band_close(image);
+	}
 
 	if ((fout = image_create_file(image, filename, -1)) == NULL) {
 		return EZ_ERR_FILE;
@@ -3982,39 +6582,54 @@ static int image_gdcanvas_save(EZIMG *image, char *filename)
 	if (image->sysopt->flags & EZOP_TRANSPARENT) {
 		gdImageColorTransparent(image->gdcanvas, image->color_canvas);
 	}
+	rc = image_gd_output(image, image->gdcanvas, fout);
+	fclose(fout);
+	return rc;
+}
+
+/* 20181018 stream the GD image into the file. The encoder writes as it 
+ * goes so the encoding and the writing are timed as one stage, and no
+ * copy of the encoded image is held in memory */
+static int image_gd_output(EZIMG *image, gdImage *img, FILE *fout)
+{
+	int64_t	tmark;
+
+	tmark = av_gettime();
 	switch (EZ_IMG_FMT_GET(image->sysopt->img_format)) {
 	case EZ_IMG_FMT_PNG:
-		gdImagePng(image->gdcanvas, fout);
+		gdImagePng(img, fout);
 		break;
 	case EZ_IMG_FMT_GIF:
 	case EZ_IMG_FMT_GIFA:
-		gdImageGif(image->gdcanvas, fout);
+		gdImageGif(img, fout);
 		break;
 	default:
-		gdImageJpeg(image->gdcanvas, fout, 
+		gdImageJpeg(img, fout, 
 				EZ_IMG_PARAM_GET(image->sysopt->img_format));
 		break;
 	}
-	fclose(fout);
-	return EZ_ERR_NONE;
+	fflush(fout);
+	image->stat->t_encode += av_gettime() - tmark;
+	return ferror(fout) ? EZ_ERR_FILE : EZ_ERR_NONE;
 }
 
-/* This function is used to paste a screen shot into the canvas */
-static int image_gdcanvas_update(EZIMG *image, int idx)
+/* This function is used to paste a screen shot into the canvas. 
+ * 20181018 The RGB24 rows of the scaled frame are packed straight into
+ * the cell of the canvas, then the edge and the timestamp are drawn in 
+ * place, so the GD frame and the gdImageCopy() are bypassed */
+static int image_gdcanvas_update(EZIMG *image, AVFrame *frame, int idx,
+		char *timestamp)
 {
-	int	col, row, i, x, y;
-
-	/* draw the edge inside the screen shot */
-	for (i = 0; i < image->sysopt->edge_width; i++) {
-		gdImageRectangle(image->gdframe, i, i, 
-				image->dst_width - i - 1,
-				image->dst_height - i - 1, 
-				image->color_edge);
-	}
+	unsigned char	*src;
+	int	*dst;
+	int	col, row, i, x, y, w, h;
 
 	row = idx / image->grid_col;
 	col = idx % image->grid_col;
 
+	/* move the banded canvas to the row */
+	image_band_seek(image, row);
+
 	x = image->rim_width + (image->dst_width + image->gap_width) * col;
 	y = image->canvas_minfo + image->rim_height + 
 		(image->dst_height + image->gap_height) * row;
@@ -4028,9 +6643,46 @@ static int image_gdcanvas_update(EZIMG *image, int idx)
 			y + image->sysopt->shadow_width + image->dst_height -1,
 			image->color_shadow);
 	}
-	/*gdImageCopy(image->gdcanvas, image->gdframe, x, y, 0, 0, 
-			image->dst_width, image->dst_height);*/
-	image_copy(image->gdcanvas, image->gdframe, x, y, 0, 0);
+
+	/* clip the cell by the canvas */
+	w = gdImageSX(image->gdcanvas) - x;
+	w = (w < image->dst_width) ? w : image->dst_width;
+	h = gdImageSY(image->gdcanvas) - y;
+	h = (h < image->dst_height) ? h : image->dst_height;
+	if ((w <= 0) || (h <= 0) || !gdImageTrueColor(image->gdcanvas)) {
+		return EZ_ERR_FORMAT;
+	}
+
+	src = frame->data[0];
+	for (row = 0; row < h; row++) {
+		dst = image->gdcanvas->tpixels[y + row] + x;
+		for (col = 0; col < w; col++) {
+			dst[col] = gdTrueColor(src[col*3], src[col*3+1], 
+					src[col*3+2]);
+		}
+		src += frame->linesize[0];
+	}
+
+	/* write the timestamp inside the cell */
+	if (timestamp) {
+#ifdef	HAVE_GDIMAGESETCLIP
+		gdImageSetClip(image->gdcanvas, x, y, x + w - 1, y + h - 1);
+#endif
+		image_gdframe_timestamp(image, image->gdcanvas, x, y, timestamp);
+#ifdef	HAVE_GDIMAGESETCLIP
+		gdImageSetClip(image->gdcanvas, 0, 0, 
+				gdImageSX(image->gdcanvas) - 1,
+				gdImageSY(image->gdcanvas) - 1);
+#endif
+	}
+
+	/* draw the edge inside the screen shot */
+	for (i = 0; i < image->sysopt->edge_width; i++) {
+		gdImageRectangle(image->gdcanvas, x + i, y + i, 
+				x + image->dst_width - i - 1,
+				y + image->dst_height - i - 1, 
+				image->color_edge);
+	}
 	return EZ_ERR_NONE;
 }
 
@@ -4248,53 +6900,371 @@ static int image_gdcanvas_background(EZIMG *image)
 #ifdef	HAVE_GDIMAGEGIFANIMBEGIN
 static FILE *image_gif_anim_open(EZIMG *image, char *filename)
 {
-	gdImage	*imgif;
+	EZGIFX	*gifx;
 	FILE	*fout;
+	int	size;
 
 	if ((fout = image_create_file(image, filename, -1)) == NULL) {
 		return NULL;
 	}
 
-	imgif = gdImageCreate(image->dst_width, image->dst_height);
-	if (imgif == NULL) {
+	size = image->dst_width * image->dst_height;
+	if ((gifx = smm_alloc(sizeof(EZGIFX) + size * 5)) == NULL) {
 		fclose(fout);
 		return NULL;
 	}
+	gifx->fout   = fout;
+	gifx->global = image->sysopt->gif_palette == EZ_GIFPAL_GLOBAL;
+	gifx->screen = (int *) (gifx + 1);
+	gifx->index  = (unsigned char *) (gifx->screen + size);
+	image->gifx_enc = gifx;
 
-	/* set the background and the default palette */
-	gdImageColorAllocate(imgif, 255, 255, 255);
-	/* write the GIF head, frame and the global palette,
-	 * but we don't use it */
-	gdImageGifAnimBegin(imgif, fout, 1, 0);
-
-	gdImageDestroy(imgif);
+	/* the GIF head with the global palette would be written after the
+	 * palette were made of the sample shots */
+	if (!gifx->global) {
+		image_gif_anim_begin(gifx, image->dst_width, image->dst_height);
+	}
 	return fout;
 }
 
 static int image_gif_anim_add(EZIMG *image, FILE *fout, int interval)
 {
+	EZGIFX	*gifx = image->gifx_enc;
 	gdImage	*imgif;
 
-	/*imgif = gdImageCreate(image->dst_width, image->dst_height);
-	gdImagePaletteCopy (imgif, imlast);
-	gdImageColorAllocate(imgif, 255, 255, 255);*/
-	//trans = gdImageColorAllocate(imlast, 1, 1, 1);
-	//gdImageColorTransparent (imgif, trans);
-	//gdImageCopy(imgif, image->gdframe, 0, 0, 0, 0,
-	//		image->dst_width, image->dst_height);
-	imgif = gdImageCreatePaletteFromTrueColor(image->gdframe, 1, 256);
-	gdImageGifAnimAdd(imgif, fout, 1, 0, 0, 	/* local palette */
-			interval, gdDisposalNone, NULL);
+	(void) fout;
+	if (gifx->global == 0) {
+		image_gif_histogram(gifx, image->gdframe);
+		image_gif_palette(gifx);
+		return image_gif_frame(image, gifx, image->gdframe, interval);
+	}
+	if (gifx->samples < 0) {	/* the global palette is ready */
+		return image_gif_frame(image, gifx, image->gdframe, interval);
+	}
 
-	gdImageDestroy(imgif);
+	/* buffer the shots until enough samples for the global palette */
+	imgif = gdImageCreateTrueColor(image->dst_width, image->dst_height);
+	if (imgif == NULL) {
+		image_gif_flush(image, gifx, interval);
+		return image_gif_frame(image, gifx, image->gdframe, interval);
+	}
+	gdImageCopy(imgif, image->gdframe, 0, 0, 0, 0, 
+			image->dst_width, image->dst_height);
+	gifx->sample[gifx->samples++] = imgif;
+	if (gifx->samples == EZ_GIFX_SAMPLES) {
+		image_gif_flush(image, gifx, interval);
+	}
 	return 0;
 }
 
 static int image_gif_anim_close(EZIMG *image, FILE *fout)
 {
-	(void) image;		/* stop the gcc warning */
+	EZGIFX	*gifx = image->gifx_enc;
+
+	if (gifx->global && (gifx->samples > 0)) {
+		image_gif_flush(image, gifx, image->gifx_opt);
+	}
+	if (gifx->global && (gifx->samples == 0)) {
+		/* nothing was taken so write an empty animation */
+		image_gif_palette(gifx);
+		image_gif_anim_begin(gifx, image->dst_width, image->dst_height);
+	}
 	gdImageGifAnimEnd(fout);
 	fclose(fout);
+	smm_free(gifx);
+	image->gifx_enc = NULL;
+	return 0;
+}
+
+/* write the GIF head. In the global palette mode, the palette goes with
+ * the head; otherwise a dummy palette is written but we don't use it */
+static int image_gif_anim_begin(EZGIFX *gifx, int width, int height)
+{
+	gdImage	*imgif;
+	int	i;
+
+	if ((imgif = gdImageCreate(width, height)) == NULL) {
+		return -1;
+	}
+	if (gifx->global) {
+		for (i = 0; i < 256; i++) {
+			gdImageColorAllocate(imgif, gifx->red[i], 
+					gifx->green[i], gifx->blue[i]);
+		}
+	} else {
+		gdImageColorAllocate(imgif, 255, 255, 255);
+	}
+	gdImageGifAnimBegin(imgif, gifx->fout, 1, 0);
+	gdImageDestroy(imgif);
+	return 0;
+}
+
+/* collect the RGB15 histogram from every other pixels and rows */
+static int image_gif_histogram(EZGIFX *gifx, gdImage *src)
+{
+	int	x, y, c;
+
+	for (y = 0; y < gdImageSY(src); y += 2) {
+		for (x = 0; x < gdImageSX(src); x += 2) {
+			c = src->tpixels[y][x];
+			gifx->hist[EZ_GIFX_RGB15(gdTrueColorGetRed(c),
+					gdTrueColorGetGreen(c),
+					gdTrueColorGetBlue(c))]++;
+		}
+	}
+	return 0;
+}
+
+/* make the palette from the histogram by the median cut. The box with
+ * the largest population times length is split at the median of its 
+ * longest axis. The mean colors of the boxes are refined by one pass of
+ * the k-means over the bins. The histogram is cleared afterward */
+static int image_gif_palette(EZGIFX *gifx)
+{
+	EZGIFBOX	*box, *newbox;
+	int64_t	sum[EZ_GIFX_COLORS][4];
+	int	i, k, n, best, cum[32], cut, c;
+
+	for (i = n = 0; i < 32768; i++) {
+		if (gifx->hist[i]) {
+			gifx->bins[n++] = i;
+		}
+	}
+	gifx->colors = 0;
+	if (n > 0) {
+		gifx->box[0].from = 0;
+		gifx->box[0].num  = n;
+		image_gif_box_measure(gifx, &gifx->box[0]);
+		gifx->colors = 1;
+	}
+	while (gifx->colors < EZ_GIFX_COLORS) {
+		for (i = 0, best = -1; i < gifx->colors; i++) {
+			box = &gifx->box[i];
+			if (box->num < 2) {
+				continue;
+			}
+			if ((best < 0) || ((int64_t) box->weight * box->span >
+					(int64_t) gifx->box[best].weight * 
+					gifx->box[best].span)) {
+				best = i;
+			}
+		}
+		if (best < 0) {
+			break;	/* every box has only one bin */
+		}
+		box = &gifx->box[best];
+
+		/* find the median in the longest axis */
+		memset(cum, 0, sizeof(cum));
+		for (i = box->from; i < box->from + box->num; i++) {
+			cum[EZ_GIFX_AXIS(gifx->bins[i], box->axis)] += 
+				gifx->hist[gifx->bins[i]];
+		}
+		for (cut = c = 0; cut < 31; cut++) {
+			if ((c += cum[cut]) >= box->weight / 2) {
+				break;
+			}
+		}
+		if (cut >= box->low + box->span) {
+			cut = box->low + box->span - 1;
+		}
+
+		/* partition the bins by the median */
+		i = box->from;
+		k = box->from + box->num - 1;
+		while (i <= k) {
+			if (EZ_GIFX_AXIS(gifx->bins[i], box->axis) <= cut) {
+				i++;
+			} else {
+				c = gifx->bins[i];
+				gifx->bins[i] = gifx->bins[k];
+				gifx->bins[k--] = c;
+			}
+		}
+		newbox = &gifx->box[gifx->colors++];
+		newbox->from = i;
+		newbox->num  = box->from + box->num - i;
+		box->num = i - box->from;
+		image_gif_box_measure(gifx, box);
+		image_gif_box_measure(gifx, newbox);
+	}
+
+	/* the mean colors of the boxes */
+	memset(sum, 0, sizeof(sum));
+	for (k = 0; k < gifx->colors; k++) {
+		box = &gifx->box[k];
+		for (i = box->from; i < box->from + box->num; i++) {
+			c = gifx->hist[gifx->bins[i]];
+			sum[k][0] += (int64_t) c * EZ_GIFX_RGB8(gifx->bins[i], 0);
+			sum[k][1] += (int64_t) c * EZ_GIFX_RGB8(gifx->bins[i], 1);
+			sum[k][2] += (int64_t) c * EZ_GIFX_RGB8(gifx->bins[i], 2);
+			sum[k][3] += c;
+		}
+		gifx->red[k]   = (int)(sum[k][0] / sum[k][3]);
+		gifx->green[k] = (int)(sum[k][1] / sum[k][3]);
+		gifx->blue[k]  = (int)(sum[k][2] / sum[k][3]);
+	}
+
+	/* one pass of the k-means */
+	memset(sum, 0, sizeof(sum));
+	for (i = 0; i < n; i++) {
+		k = image_gif_nearest(gifx, EZ_GIFX_RGB8(gifx->bins[i], 0),
+				EZ_GIFX_RGB8(gifx->bins[i], 1),
+				EZ_GIFX_RGB8(gifx->bins[i], 2));
+		c = gifx->hist[gifx->bins[i]];
+		sum[k][0] += (int64_t) c * EZ_GIFX_RGB8(gifx->bins[i], 0);
+		sum[k][1] += (int64_t) c * EZ_GIFX_RGB8(gifx->bins[i], 1);
+		sum[k][2] += (int64_t) c * EZ_GIFX_RGB8(gifx->bins[i], 2);
+		sum[k][3] += c;
+	}
+	for (k = 0; k < gifx->colors; k++) {
+		if (sum[k][3]) {
+			gifx->red[k]   = (int)(sum[k][0] / sum[k][3]);
+			gifx->green[k] = (int)(sum[k][1] / sum[k][3]);
+			gifx->blue[k]  = (int)(sum[k][2] / sum[k][3]);
+		}
+	}
+	if (gifx->colors == 0) {
+		gifx->colors = 1;	/* black */
+	}
+	for (k = gifx->colors; k < 256; k++) {
+		gifx->red[k] = gifx->green[k] = gifx->blue[k] = 0;
+	}
+
+	memset(gifx->lookup, 0xff, sizeof(gifx->lookup));
+	memset(gifx->hist, 0, sizeof(gifx->hist));
+	return gifx->colors;
+}
+
+static int image_gif_box_measure(EZGIFX *gifx, EZGIFBOX *box)
+{
+	int	i, a, v, lo[3], hi[3];
+
+	lo[0] = lo[1] = lo[2] = 31;
+	hi[0] = hi[1] = hi[2] = 0;
+	box->weight = 0;
+	for (i = box->from; i < box->from + box->num; i++) {
+		for (a = 0; a < 3; a++) {
+			v = EZ_GIFX_AXIS(gifx->bins[i], a);
+			lo[a] = v < lo[a] ? v : lo[a];
+			hi[a] = v > hi[a] ? v : hi[a];
+		}
+		box->weight += gifx->hist[gifx->bins[i]];
+	}
+	box->axis = 0;
+	for (a = 1; a < 3; a++) {
+		if (hi[a] - lo[a] > hi[box->axis] - lo[box->axis]) {
+			box->axis = a;
+		}
+	}
+	box->low  = lo[box->axis];
+	box->span = hi[box->axis] - lo[box->axis];
+	return box->span;
+}
+
+static int image_gif_nearest(EZGIFX *gifx, int r, int g, int b)
+{
+	int	i, d, best, dist;
+
+	for (i = best = 0, dist = 0x7fffffff; i < gifx->colors; i++) {
+		d = (gifx->red[i] - r) * (gifx->red[i] - r) +
+			(gifx->green[i] - g) * (gifx->green[i] - g) +
+			(gifx->blue[i] - b) * (gifx->blue[i] - b);
+		if (d < dist) {
+			dist = d;
+			best = i;
+		}
+	}
+	return best;
+}
+
+/* quantize the shot by the palette and encode the rectangle changed from
+ * the previous frame. The unchanged pixels inside the rectangle are 
+ * transparent, which is kept by the gdDisposalNone */
+static int image_gif_frame(EZIMG *image, EZGIFX *gifx, gdImage *src, 
+		int interval)
+{
+	gdImage	*imgif;
+	int	x, y, c, k, left, top, right, bottom, *scr;
+	unsigned char	*idx;
+
+	/* quantize the shot and find the changed rectangle */
+	left = image->dst_width;
+	top  = image->dst_height;
+	right = bottom = -1;
+	for (y = 0; y < image->dst_height; y++) {
+		idx = gifx->index + y * image->dst_width;
+		scr = gifx->screen + y * image->dst_width;
+		for (x = 0; x < image->dst_width; x++) {
+			c = src->tpixels[y][x];
+			k = EZ_GIFX_RGB15(gdTrueColorGetRed(c), 
+					gdTrueColorGetGreen(c),
+					gdTrueColorGetBlue(c));
+			if (gifx->lookup[k] < 0) {
+				gifx->lookup[k] = (short) image_gif_nearest(
+						gifx, EZ_GIFX_RGB8(k, 0),
+						EZ_GIFX_RGB8(k, 1),
+						EZ_GIFX_RGB8(k, 2));
+			}
+			idx[x] = (unsigned char) gifx->lookup[k];
+			c = gdTrueColor(gifx->red[idx[x]], 
+					gifx->green[idx[x]],
+					gifx->blue[idx[x]]);
+			if (gifx->frames && (scr[x] == c)) {
+				idx[x] = EZ_GIFX_COLORS;  /* unchanged */
+				continue;
+			}
+			scr[x] = c;
+			left   = x < left ? x : left;
+			right  = x > right ? x : right;
+			top    = y < top ? y : top;
+			bottom = y;
+		}
+	}
+	if (right < 0) {	/* nothing changed */
+		left = right = top = bottom = 0;
+	}
+
+	imgif = gdImageCreate(right - left + 1, bottom - top + 1);
+	if (imgif == NULL) {
+		return -1;
+	}
+	for (c = 0; c < 256; c++) {
+		gdImageColorAllocate(imgif, gifx->red[c], 
+				gifx->green[c], gifx->blue[c]);
+	}
+	if (gifx->frames) {
+		gdImageColorTransparent(imgif, EZ_GIFX_COLORS);
+	}
+	for (y = top; y <= bottom; y++) {
+		idx = gifx->index + y * image->dst_width;
+		for (x = left; x <= right; x++) {
+			imgif->pixels[y - top][x - left] = idx[x];
+		}
+	}
+	gdImageGifAnimAdd(imgif, gifx->fout, !gifx->global, left, top,
+			interval, gdDisposalNone, NULL);
+	gdImageDestroy(imgif);
+	gifx->frames++;
+	return 0;
+}
+
+/* make the global palette from the buffered shots, write the GIF head
+ * and the buffered shots */
+static int image_gif_flush(EZIMG *image, EZGIFX *gifx, int interval)
+{
+	int	i;
+
+	for (i = 0; i < gifx->samples; i++) {
+		image_gif_histogram(gifx, gifx->sample[i]);
+	}
+	image_gif_palette(gifx);
+	image_gif_anim_begin(gifx, image->dst_width, image->dst_height);
+	for (i = 0; i < gifx->samples; i++) {
+		image_gif_frame(image, gifx, gifx->sample[i], interval);
+		gdImageDestroy(gifx->sample[i]);
+	}
+	gifx->samples = -1;	/* the global palette is ready */
 	return 0;
 }
 #endif 	/* HAVE_GDIMAGEGIFANIMBEGIN */
@@ -4417,6 +7387,374 @@ static int image_copy(gdImage *dst, gdImage *src, int x, int y,
 }
 
 
+/* 20181018 The banded canvas only allocates the rows of one band, which
+ * is a grid row of shots plus the gap. The first band includes the media
+ * information and the last band includes the status line. The GD image is
+ * hacked into the full size of the canvas, where the rows out of the band
+ * point to a dummy row, so all the drawing functions work as usual.
+ * The band is encoded into the file when the shots moved to the next row.
+ * It only works with JPEG and PNG without the background picture */
+static gdImage *image_band_create(EZIMG *image)
+{
+#ifdef	EZ_BANDED
+	gdImage	*canvas;
+	int	**rows, i, fmt;
+
+	fmt = EZ_IMG_FMT_GET(image->sysopt->img_format);
+	if (((image->sysopt->flags & EZOP_BANDED) == 0) || 
+			image->sysopt->background || (image->grid_row < 2)) {
+		return NULL;
+	}
+#ifdef	HAVE_JPEGLIB_H
+	if (fmt == EZ_IMG_FMT_JPEG) {
+		fmt = -1;
+	}
+#endif
+#ifdef	HAVE_PNG_H
+	if (fmt == EZ_IMG_FMT_PNG) {
+		fmt = -1;
+	}
+#endif
+	if (fmt != -1) {
+		return NULL;	/* not supported format */
+	}
+
+	image->band_num = image_band_top(image, 1);
+	i = image->canvas_height - image_band_top(image, image->grid_row - 1);
+	if (image->band_num < i) {
+		image->band_num = i;
+	}
+	if ((rows = smm_alloc(sizeof(int*) * image->canvas_height)) == NULL) {
+		return NULL;
+	}
+	image->band_dummy = smm_alloc(sizeof(int) * image->canvas_width);
+	if (image->band_dummy == NULL) {
+		smm_free(rows);
+		return NULL;
+	}
+	canvas = gdImageCreateTrueColor(image->canvas_width, image->band_num);
+	if (canvas == NULL) {
+		smm_free(image->band_dummy);
+		image->band_dummy = NULL;
+		smm_free(rows);
+		return NULL;
+	}
+
+	/* hack the GD image into the full size of the canvas */
+	for (i = 0; i < image->canvas_height; i++) {
+		rows[i] = image->band_dummy;
+	}
+	image->band_rows = canvas->tpixels;
+	canvas->tpixels  = rows;
+	canvas->sy  = image->canvas_height;
+	canvas->cy2 = image->canvas_height - 1;
+
+	image->gdcanvas  = canvas;
+	image->band_grid = 0;
+	image_band_map(image, 0);
+	CDB_DEBUG(("image_band_create: %d of %d rows\n", 
+				image->band_num, image->canvas_height));
+	return canvas;
+#else
+	(void) image;
+	return NULL;
+#endif
+}
+
+static int image_band_free(EZIMG *image)
+{
+#ifdef	EZ_BANDED
+	if (image->band_rows == NULL) {
+		return EZ_ERR_NONE;
+	}
+	image_band_abort(image);
+
+	/* restore the GD image so it can be destroyed */
+	smm_free(image->gdcanvas->tpixels);
+	image->gdcanvas->tpixels = image->band_rows;
+	image->gdcanvas->sy  = image->band_num;
+	image->gdcanvas->cy2 = image->band_num - 1;
+	image->band_rows = NULL;
+	smm_free(image->band_dummy);
+	image->band_dummy = NULL;
+#else
+	(void) image;
+#endif
+	return EZ_ERR_NONE;
+}
+
+/* the first canvas row of the band */
+static int image_band_top(EZIMG *image, int grid)
+{
+	if (grid <= 0) {
+		return 0;
+	}
+	if (grid >= image->grid_row) {
+		return image->canvas_height;
+	}
+	return image->canvas_minfo + image->rim_height + 
+		(image->dst_height + image->gap_height) * grid;
+}
+
+/* point the canvas rows of the grid row to the band */
+static int image_band_map(EZIMG *image, int grid)
+{
+	int	**tpixels = image->gdcanvas->tpixels;
+	int	i, top, end;
+
+	top = image_band_top(image, image->band_grid);
+	end = image_band_top(image, image->band_grid + 1);
+	for (i = top; i < end; i++) {
+		tpixels[i] = image->band_dummy;
+	}
+
+	image->band_grid = grid;
+	top = image_band_top(image, grid);
+	end = image_band_top(image, grid + 1);
+	for (i = top; i < end; i++) {
+		tpixels[i] = image->band_rows[i - top];
+		memset(tpixels[i], 0, sizeof(int) * image->canvas_width);
+	}
+	return end - top;
+}
+
+/* encode the bands before the grid row and move the band to it */
+static int image_band_seek(EZIMG *image, int grid)
+{
+	int64_t	tmark;
+
+	if (image->band_rows == NULL) {
+		return 0;
+	}
+	if (grid >= image->grid_row) {
+		grid = image->grid_row - 1;
+	}
+	while (image->band_grid < grid) {
+		tmark = av_gettime();
+		image_band_write(image);
+		image->stat->t_encode += av_gettime() - tmark;
+		image_band_map(image, image->band_grid + 1);
+		gdImageFilledRectangle(image->gdcanvas, 0, 
+				image_band_top(image, image->band_grid),
+				image->canvas_width - 1,
+				image_band_top(image, image->band_grid + 1) - 1,
+				image->color_canvas);
+	}
+	return image->band_grid;
+}
+
+static int image_band_open(EZIMG *image, char *filename)
+{
+#ifdef	EZ_BANDED
+	EZBAND	*band;
+	int	quality;
+
+	if ((image->band_rows == NULL) || image->band_enc) {
+		return EZ_ERR_NONE;
+	}
+	band = smm_alloc(sizeof(EZBAND) + image->canvas_width * 3);
+	if (band == NULL) {
+		return EZ_ERR_LOWMEM;
+	}
+	band->line   = (unsigned char *) &band[1];
+	band->format = EZ_IMG_FMT_GET(image->sysopt->img_format);
+	if ((band->fout = image_create_file(image, filename, -1)) == NULL) {
+		smm_free(band);
+		return EZ_ERR_FILE;
+	}
+	image->band_enc = band;
+
+	if (setjmp(band->jmpbuf)) {
+		CDB_ERROR(("%s: failed to start the encoder\n", filename));
+		image_band_abort(image);
+		return EZ_ERR_FILE;
+	}
+#ifdef	HAVE_JPEGLIB_H
+	if (band->format == EZ_IMG_FMT_JPEG) {
+		band->jcom.err = jpeg_std_error(&band->jerr);
+		band->jerr.error_exit = image_band_jpeg_error;
+		jpeg_create_compress(&band->jcom);
+		band->jcom.client_data = band;
+		jpeg_stdio_dest(&band->jcom, band->fout);
+		band->jcom.image_width  = image->canvas_width;
+		band->jcom.image_height = image->canvas_height;
+		band->jcom.input_components = 3;
+		band->jcom.in_color_space = JCS_RGB;
+		jpeg_set_defaults(&band->jcom);
+		quality = EZ_IMG_PARAM_GET(image->sysopt->img_format);
+		if (quality > 0) {
+			jpeg_set_quality(&band->jcom, quality, TRUE);
+		}
+		jpeg_start_compress(&band->jcom, TRUE);
+	}
+#endif
+#ifdef	HAVE_PNG_H
+	if (band->format == EZ_IMG_FMT_PNG) {
+		png_color_16	trans;
+
+		band->png = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+				band, image_band_png_error, NULL);
+		if (band->png == NULL) {
+			image_band_abort(image);
+			return EZ_ERR_LOWMEM;
+		}
+		if ((band->info = png_create_info_struct(band->png)) == NULL) {
+			image_band_abort(image);
+			return EZ_ERR_LOWMEM;
+		}
+		png_init_io(band->png, band->fout);
+		png_set_IHDR(band->png, band->info, 
+				image->canvas_width, image->canvas_height, 
+				8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+				PNG_COMPRESSION_TYPE_DEFAULT, 
+				PNG_FILTER_TYPE_DEFAULT);
+		if (image->sysopt->flags & EZOP_TRANSPARENT) {
+			memset(&trans, 0, sizeof(trans));
+			trans.red   = gdTrueColorGetRed(image->color_canvas);
+			trans.green = gdTrueColorGetGreen(image->color_canvas);
+			trans.blue  = gdTrueColorGetBlue(image->color_canvas);
+			png_set_tRNS(band->png, band->info, NULL, 0, &trans);
+		}
+		png_write_info(band->png, band->info);
+	}
+#endif
+	(void) quality;
+	return EZ_ERR_NONE;
+#else
+	(void) image; (void) filename;
+	return EZ_ERR_FORMAT;
+#endif
+}
+
+/* encode the rows of the current band */
+static int image_band_write(EZIMG *image)
+{
+#ifdef	EZ_BANDED
+	EZBAND	*band = image->band_enc;
+	unsigned char	*p;
+	int	*src, x, y, end;
+
+	if (band == NULL) {
+		return EZ_ERR_NONE;
+	}
+	if (setjmp(band->jmpbuf)) {
+		CDB_ERROR(("image_band_write: failed to encode\n"));
+		image_band_abort(image);
+		return EZ_ERR_FILE;
+	}
+
+	y   = image_band_top(image, image->band_grid);
+	end = image_band_top(image, image->band_grid + 1);
+	for ( ; y < end; y++) {
+		src = image->gdcanvas->tpixels[y];
+		for (x = 0, p = band->line; x < image->canvas_width; x++) {
+			*p++ = gdTrueColorGetRed(src[x]);
+			*p++ = gdTrueColorGetGreen(src[x]);
+			*p++ = gdTrueColorGetBlue(src[x]);
+		}
+#ifdef	HAVE_JPEGLIB_H
+		if (band->format == EZ_IMG_FMT_JPEG) {
+			JSAMPROW	row = band->line;
+			jpeg_write_scanlines(&band->jcom, &row, 1);
+		}
+#endif
+#ifdef	HAVE_PNG_H
+		if (band->format == EZ_IMG_FMT_PNG) {
+			png_write_row(band->png, band->line);
+		}
+#endif
+	}
+#else
+	(void) image;
+#endif
+	return EZ_ERR_NONE;
+}
+
+/* encode the rest of the bands and close the file */
+static int image_band_close(EZIMG *image)
+{
+#ifdef	EZ_BANDED
+	EZBAND	*band;
+	int64_t	tmark;
+
+	/* the bands passed by are timed by image_band_seek() so only the 
+	 * last band and the finishing are timed here */
+	image_band_seek(image, image->grid_row - 1);
+	tmark = av_gettime();
+	image_band_write(image);
+	if ((band = image->band_enc) == NULL) {
+		image->stat->t_encode += av_gettime() - tmark;
+		return EZ_ERR_FILE;
+	}
+	if (setjmp(band->jmpbuf)) {
+		CDB_ERROR(("image_band_close: failed to encode\n"));
+		image_band_abort(image);
+		image->stat->t_encode += av_gettime() - tmark;
+		return EZ_ERR_FILE;
+	}
+#ifdef	HAVE_JPEGLIB_H
+	if (band->format == EZ_IMG_FMT_JPEG) {
+		jpeg_finish_compress(&band->jcom);
+	}
+#endif
+#ifdef	HAVE_PNG_H
+	if (band->format == EZ_IMG_FMT_PNG) {
+		png_write_end(band->png, NULL);
+	}
+#endif
+	image_band_abort(image);
+	image->stat->t_encode += av_gettime() - tmark;
+	return EZ_ERR_NONE;
+#else
+	(void) image;
+	return EZ_ERR_FORMAT;
+#endif
+}
+
+#ifdef	EZ_BANDED
+/* release the encoder and close the file */
+static int image_band_abort(EZIMG *image)
+{
+	EZBAND	*band = image->band_enc;
+
+	if (band == NULL) {
+		return EZ_ERR_NONE;
+	}
+#ifdef	HAVE_JPEGLIB_H
+	if (band->jcom.err) {
+		jpeg_destroy_compress(&band->jcom);
+	}
+#endif
+#ifdef	HAVE_PNG_H
+	if (band->png) {
+		png_destroy_write_struct(&band->png, 
+				band->info ? &band->info : NULL);
+	}
+#endif
+	fclose(band->fout);
+	smm_free(band);
+	image->band_enc = NULL;
+	return EZ_ERR_NONE;
+}
+#endif
+
+#ifdef	HAVE_JPEGLIB_H
+static void image_band_jpeg_error(j_common_ptr cinfo)
+{
+	longjmp(((EZBAND *) cinfo->client_data)->jmpbuf, 1);
+}
+#endif
+
+#ifdef	HAVE_PNG_H
+static void image_band_png_error(png_structp png, png_const_charp msg)
+{
+	CDB_ERROR(("PNG: %s\n", msg));
+	(void) msg;
+	longjmp(((EZBAND *) png_get_error_ptr(png))->jmpbuf, 1);
+}
+#endif
+
+
 /****************************************************************************
  * Filename process
  ****************************************************************************/
@@ -4602,6 +7940,9 @@ static int ezdefault(EZOPT *ezopt, int event,
 		case ENX_SS_TWOPASS:
 			CDB_SHOW(("Building (2Pass)     "));
 			break;
+		case ENX_SS_ONEPASS:
+			CDB_SHOW(("Building (1Pass)     "));
+			break;
 		case ENX_SS_HEURIS:
 			CDB_SHOW(("Building (Heur)      "));
 			break;
@@ -4623,6 +7964,11 @@ static int ezdefault(EZOPT *ezopt, int event,
 	case EN_PROC_END:
 		CDB_SHOW((" %ldx%ld done\n", param, opt));
 		break;
+	case EN_PROC_STATS:
+		if (ezopt && ezopt->stats) {
+			dump_video_stats(block, ezopt->stats);
+		}
+		break;
 	case EN_PROC_SAVED:
 		myntf = block;
 		vidx  = myntf->varg1;
@@ -4840,6 +8186,55 @@ static int dump_media_statistic(struct MeStat *mestat, int n, EZVID *vidx)
 	return 0;
 }
 
+/* 20181018 append the counters of the video as a JSON line. The frames
+ * decoded but not taken as shots are counted as discarded */
+static int dump_video_stats(EZVID *vidx, char *fname)
+{
+	EZSTAT	*st = &vidx->stat;
+	FILE	*fout;
+	char	name[1024], buf[2048];
+	long	discard;
+
+	discard = (long)(st->frames - st->shots);
+	if (discard < 0) {
+		discard = 0;
+	}
+	snprintf(buf, sizeof(buf), "{\"file\":%s,\"size\":%lld,"
+		"\"duration\":%lld,\"seekable\":%d,\"process\":%d,"
+		"\"open_us\":%lld,\"info_us\":%lld,\"challenge_us\":%lld,"
+		"\"duration_us\":%lld,\"seeks\":%lu,\"seek_us\":%lld,"
+		"\"packets\":%lu,\"bytes\":%lld,\"io_seeks\":%lu,\"decoded\":%lu,"
+		"\"frames\":%lu,\"discarded\":%ld,\"shots\":%lu,"
+		"\"scale_us\":%lld,\"psnr\":%.2f,\"compose_us\":%lld,"
+		"\"encode_us\":%lld,\"total_us\":%lld}\n",
+		meta_json_string(vidx->filename, name, sizeof(name)),
+		(long long) vidx->filesize, (long long) vidx->duration,
+		vidx->seekable, EZOP_PROC(vidx->ses_flags),
+		(long long) st->t_open, (long long) st->t_info,
+		(long long) st->t_challenge, (long long) st->t_duration,
+		st->seeks, (long long) st->t_seek,
+		st->packets, (long long) st->bytes, st->ioseeks, st->decoded,
+		st->frames, discard, st->shots,
+		(long long) st->t_scale, 
+		st->psnr_num ? st->psnr / st->psnr_num : 0.0,
+		(long long) st->t_compose,
+		(long long) st->t_encode,
+		(long long)(av_gettime() - st->t_start));
+
+	if (!strcmp(fname, "-")) {
+		fputs(buf, stdout);
+		fflush(stdout);
+		return 0;
+	}
+	if ((fout = fopen(fname, "a")) == NULL) {
+		perror(fname);
+		return -1;
+	}
+	fputs(buf, fout);
+	fclose(fout);
+	return 0;
+}
+
 static int dump_format_context(AVFormatContext *format)
 {
 #ifdef	HAVE_AVFORMATCONTEXT_FILE_SIZE
@@ -83,6 +83,22 @@
 #define EN_OPEN_END		1032	/* end of the checking */
 #define EN_BATCH_BEGIN		1033
 #define EN_BATCH_END		1034
+#define EN_PROC_STATS		1035	/* the counters of the closing video */
+
+/* 20181018 the event-interest mask. The events from EN_FILE_OPEN to 
+ * EN_BATCH_END can be masked out; others are always dispatched */
+#define EN_EVENT_BIT(e)		(1ULL << ((e) - EN_FILE_OPEN))
+#define EN_EVENT_MASKABLE(e)	(((e) >= EN_FILE_OPEN) && \
+					((e) < EN_FILE_OPEN + 64))
+#define EN_EVENT_WANT(o,e)	(!EN_EVENT_MASKABLE(e) || \
+					((o)->ev_mask & EN_EVENT_BIT(e)))
+#define EN_EVENT_ALL		(~0ULL)
+/* the events in every packet or frame */
+#define EN_EVENT_HOT		(EN_EVENT_BIT(EN_PACKET_RECV) | \
+					EN_EVENT_BIT(EN_FRAME_DONE) | \
+					EN_EVENT_BIT(EN_OPEN_GOING))
+/* the default interval of the progress events in millisecond */
+#define EN_PROGRESS_RATE	100
 
 #define ENX_DUR_MHEAD		0	/* duration from media head */
 #define ENX_DUR_JUMP		1	/* jumping for a quick scan */
@@ -95,6 +111,7 @@
 #define ENX_SS_HEURIS		3
 #define ENX_SS_IFRAMES		4
 #define ENX_SS_SAFE		5
+#define ENX_SS_ONEPASS		6
 
 
 #define ENX_SEEK_UNKNOWN	0	/* seeking capablity unknown */
@@ -158,6 +175,7 @@
 #define EZOP_PROC_SKIM		1	/* use av_seek_frame() */
 #define EZOP_PROC_SCAN		2	/* single pass i-frame scan */
 #define EZOP_PROC_TWOPASS	3	/* two pass scan support p-frame */
+#define EZOP_PROC_ONEPASS	4	/* one pass scan support p-frame */
 #define EZOP_PROC_KEYRIP	5	/* rip key frames */
 #define EZOP_PROC_SAFE		6	/* safe mode */
 #define EZOP_PROC_MASK		15
@@ -171,6 +189,29 @@
 /* reserved space in 0x0FF00000 */
 #define EZOP_PROGRESS_BAR	0x100000  /* standalone progress UI bar */
 
+/* define the threading model of the video decoder */
+#define EZOP_THREAD_AUTO	0		/* decided by process mode */
+#define EZOP_THREAD_FRAME	0x200000	/* frame threading */
+#define EZOP_THREAD_SLICE	0x400000	/* slice threading */
+#define EZOP_THREAD_OFF		0x600000	/* single thread */
+#define EZOP_THREAD_MASK	0x600000
+#define EZOP_THREAD_SET(m,d)	((m) &= ~EZOP_THREAD_MASK, (m) |= (d))
+#define EZOP_THREAD_GET(m)	((m) & EZOP_THREAD_MASK)
+
+#define EZOP_PROBE_CACHE	0x800000  /* cache the media probe results */
+#define EZOP_LOWRES		0x1000000 /* low resolution decoding */
+
+/* define the quality tiers of the scaler */
+#define EZOP_SCALE_AUTO		0		/* decided by scaling ratio */
+#define EZOP_SCALE_FAST		0x2000000	/* fast bilinear */
+#define EZOP_SCALE_BALANCED	0x4000000	/* bicubic */
+#define EZOP_SCALE_BEST		0x6000000	/* lanczos */
+#define EZOP_SCALE_MASK		0x6000000
+#define EZOP_SCALE_SET(m,d)	((m) &= ~EZOP_SCALE_MASK, (m) |= (d))
+#define EZOP_SCALE_GET(m)	((m) & EZOP_SCALE_MASK)
+
+#define EZOP_BANDED		0x8000000 /* banded canvas */
+
 /* debug use 0xF0000000 mask in the flag word */
 #define EZDBG_NONE		SLSHOW	/* no debug information at all */
 #define EZDBG_SHOW		(SLSHOW | SLOG_FLUSH)
@@ -250,18 +291,40 @@
 #define EZ_IMG_PARAM_GET(m)	((m) & EZ_IMG_PARAM_MASK)
 #define EZ_IMG_INIT(m,d)	((m) | (d))
 
+/* define the palette of the GIF89 animation */
+#define EZ_GIFPAL_LOCAL		0	/* a palette in each frame */
+#define EZ_GIFPAL_GLOBAL	1	/* one palette of the sample shots */
+
+/* define the I/O backend of the local files */
+#define EZ_IO_AUTO		0	/* buffered reading by ezthumb */
+#define EZ_IO_FFMPEG		1	/* the file protocol of FFmpeg */
+#define EZ_IO_BUFFER		2	/* buffered reading by ezthumb */
+#define EZ_IO_MMAP		3	/* memory mapped file */
+
+/* define the access patterns of the I/O backend */
+#define EZ_IO_SEQUENTIAL	0	/* reading through */
+#define EZ_IO_RANDOM		1	/* seeking and small reads */
+#define EZ_IO_BLOCK		(64*1024)	/* buffer of AVIOContext */
+#define EZ_IO_READAHEAD		(1024*1024)	/* sequential read ahead */
+
 /* Duration Seeking Challenge Profile */
 #define EZ_DSCP_RANGE_INIT	10000	/* range of initial scan (ms) */
 #define EZ_DSCP_RANGE_EXT	10	/* extended rate of initial range */
 #define EZ_DSCP_STEP_ERROR	300	/* 30% error acceptable */
 #define EZ_DSCP_N_STEP		5	/* number of seeks */
 
+/* Tail Probe of the MPEG-TS/PS */
+#define EZ_TAIL_PROBE		(4*1024*1024)	/* first read of the tail */
+#define EZ_TAIL_PROBE_MAX	(16*1024*1024)	/* the most read */
+
 /* define the array of progress time stamp */
 #define EZ_PTS_MOPEN		'M'	/* media open */
 #define EZ_PTS_DSEEK		'S'	/* video_seek_challenge */
 #define EZ_PTS_DSCAN		'A'	/* video_duration_scan */
 #define EZ_PTS_COPEN		'C'	/* codec open */
 #define EZ_PTS_UPDATE		'U'	/* longest update */
+#define EZ_PTS_REWIND		'R'	/* rewind instead of reopen */
+#define EZ_PTS_SAVED		'V'	/* time saved by rewinding */
 #define EZ_PTS_RESET		0
 #define EZ_PTS_CLEAR		1
 #define EZ_PTS_MAX		16
@@ -313,6 +376,16 @@
 #define CFG_KEY_DURATION	"duration_mode"
 #define CFG_KEY_PROF_SIMPLE	"simple_profile"
 #define CFG_KEY_MEDIA_PROC	"media_process"
+#define CFG_KEY_DEC_THREADING	"decoder_threading"
+#define CFG_KEY_DEC_THREADS	"decoder_threads"
+#define CFG_KEY_SEEKERS		"parallel_seekers"
+#define CFG_KEY_SCALE_QUALITY	"scale_quality"
+#define CFG_KEY_BANDED		"banded_canvas"
+#define CFG_KEY_GIF_PALETTE	"gif_palette"
+#define CFG_KEY_IO_MODE		"io_backend"
+#define CFG_KEY_PROGRESS_RATE	"progress_rate"
+#define CFG_KEY_PROBE_CACHE	"probe_cache"
+#define CFG_KEY_LOWRES		"lowres_decoding"
 
 #define CFG_PIC_POS_LFETTOP	"left top"
 #define CFG_PIC_POS_LEFTCENTR	"left centre"
@@ -449,12 +522,25 @@ typedef	struct	{
 	int	key_ripno;	/* specify the number when ripping keyframes*/
 	char	*pathout;	/* output path */
 	int	grpclips;	/* number of grouped clips */
+	int	jobs;		/* number of files processed concurrently */
+	int	dec_threads;	/* number of decoder threads (0=auto) */
+	int	seekers;	/* demuxers seeking in a file (0=auto) */
+	int	gif_palette;	/* palette of GIF89 animation, EZ_GIFPAL_* */
+	int	io_mode;	/* I/O backend of local files, EZ_IO_* */
+	int	scale_bench;	/* measure the scaler against the Lanczos */
 
 	/* callback functions to indicate the progress */
 	int	(*notify)(void *nobj, int event, long param, long, void *);
 	int	(*notiback)(void *nobj, int event, long param, long, void *);
 
-	/* copy of runtime objects for signal breaking */
+	/* 20181018 the events to be dispatched, see EN_EVENT_BIT(). The 
+	 * progress events are coalesced into one per ev_rate milliseconds */
+	unsigned long long	ev_mask;
+	int	ev_rate;	/* interval of progress events (0=all) */
+	SMM_TIME	ev_tmark;	/* time of the last progress event */
+
+	/* copy of runtime objects for signal breaking. In the job mode 
+	 * each worker owns a copy of EZOPT so they are worker's private */
 	void	*vidobj;	/* copy of the runtime EZVID point */
 	void	*imgobj;	/* copy of the runtime EZIMG point */
 	
@@ -471,6 +557,13 @@ typedef	struct	{
 	EZPROF	*pro_size;	/* profile of the size of each snapshots */
 	int	pro_mask;
 	EZPROF	pro_pool[EZ_PROF_MAX_ENTRY];
+
+	/* 20181018 append the counters of each video as JSON lines */
+	char	*stats;		/* the file name, or "-" for stdout */
+
+	/* 20181018 the glyph atlases of the timestamp, shared read only by
+	 * the workers. See ezopt_atlas_setup() */
+	void	*atlas;
 } EZOPT;
 
 
@@ -487,6 +580,30 @@ typedef	struct	{
 	
 } RTOPT;
 
+typedef	struct		{	/* 20181018 the counters of a video */
+	int64_t		bytes;		/* bytes read by the demuxer */
+	unsigned long	packets;	/* packets read from the demuxer */
+	unsigned long	decoded;	/* packets sent to the decoder */
+	unsigned long	frames;		/* pictures came out of the decoder */
+	unsigned long	shots;		/* pictures taken as the shots */
+	unsigned long	seeks;		/* seeking requests */
+	unsigned long	ioseeks;	/* seeks in the I/O backend */
+	/* the time spent in each stage in microseconds */
+	int64_t		t_start;	/* timestamp of the allocation */
+	int64_t		t_open;		/* opening the media file */
+	int64_t		t_info;		/* finding the stream information */
+	int64_t		t_challenge;	/* the seek challenge */
+	int64_t		t_duration;	/* scanning the duration */
+	int64_t		t_seek;		/* seeking the shots */
+	int64_t		t_scale;	/* scaling the shots */
+	int64_t		t_compose;	/* drawing the shots onto the canvas */
+	int64_t		t_encode;	/* encoding and writing the images */
+	/* the PSNR of the scaler against the Lanczos, see scale_bench */
+	double		psnr;		/* sum of the PSNR of the shots */
+	unsigned long	psnr_num;	/* the shots measured */
+} EZSTAT;
+
+
 /* This structure is used to store the runtime parameters. Most parameters
  * are transformed from the EZOPT structure. Due to the difference of each
  * video clips, the content of this structure is dynamic in each operation */
@@ -531,10 +648,23 @@ typedef	struct	{
 	gdImage	*gdcanvas;	/* gd context for the whole canvas */
 	FILE	*gifx_fp;	/* for GIF89 animation */
 	int	gifx_opt;	/* for GIF89 animation */
+	void	*gifx_enc;	/* the frame encoder of GIF89 animation */
 
 	EZOPT	*sysopt;	/* link to the EZOPT parameters */
 	void	*cbparam;	/* the callback parameter block */
 	int	canvas_minfo;	/* height of the media info area */
+
+	/* 20181018 banded canvas: only the rows of the current band are in 
+	 * memory. Other rows of the canvas point to the dummy row */
+	int	**band_rows;	/* the rows of the band */
+	int	*band_dummy;	/* the dummy row out of the band */
+	int	band_num;	/* number of rows of the band */
+	int	band_grid;	/* the grid row in the band */
+	void	*band_enc;	/* the streaming encoder */
+
+	void	*atlas;		/* the glyph atlas in EZOPT, read only */
+	EZSTAT	*stat;		/* the counters of the video */
+
 	char	filename[1];	/* file name buffer */
 } EZIMG;
 
@@ -554,6 +684,22 @@ typedef	struct		{
 	void		*context;	/* linked packet or sws context */
 } EZFRM;
 
+#define EZ_RING_MAX		512	/* maximum packets buffered in a GOP */
+
+typedef	struct		{	/* packets buffered since the key frame */
+	AVPacket	pkt[EZ_RING_MAX];
+	int		num;		/* number of buffered packets */
+	int		dec;		/* packets sent to the decoder */
+	int		live;		/* GOP is too long to be buffered */
+	int		keyed;		/* the key frame of the GOP was read */
+	int		fresh;		/* a picture was just decoded */
+} EZRING;
+
+typedef	struct		{	/* entry of the key frame index */
+	int64_t		dts;		/* DTS of the key frame */
+	int64_t		pos;		/* byte position of the key frame */
+} EZKEY;
+
 
 typedef	struct	_EzVid	{
 	/*** video_open() / video_close() */
@@ -563,6 +709,8 @@ typedef	struct	_EzVid	{
 	int		vsidx;		/* the index of the video stream */
 	int		ezstream;	/* 20130719 recognizable streams */
 	int		dts_rate;	/* DTS per frame */
+	int		lowres;		/* lowres level of the decoder */
+	void		*ioctx;		/* the I/O backend (EZIO) */
 
 	/*** video_allocate() */
 	EZOPT		*sysopt;	/* link to the EZOPT parameters */
@@ -576,6 +724,7 @@ typedef	struct	_EzVid	{
 	int		bitrates;	/* referenced by seek challenge */
 	EZTIME		dts_offset;	/* DTS could start from here */
 	int		seekable;	/* video keyframe seekable flag */
+	int		probed;		/* probe results could be cached */
 
 	/*** video_alloc_queue() */
 	EZTIME		dur_all;	/* total duration of all clips */
@@ -593,6 +742,7 @@ typedef	struct	_EzVid	{
 	EZFRM		*swsframe;	/* scaled frame */
 	EZFRM		*picframe;	/* store the recent good frame */
 	EZFRM		*vidframe;	/* the decoding frame */
+	void		*pipeline;	/* the compose stage (EZPIPE) */
 
 	/* capture video frame for debugging */
 #if	defined(CFG_SNAPSHOT_DUMP) || defined(CFG_SNAPSHOT_RGB)
@@ -601,11 +751,14 @@ typedef	struct	_EzVid	{
 #ifdef	CFG_SNAPSHOT_DUMP
 	gdImage		*capgdimg;
 #endif
+	/* reference frame scaled by the Lanczos for measuring */
+	EZFRM		*refframe;
 
 	/*** runtime variables in each session */
 	SMM_TIME	tmark;		/* the beginning timestamp */
 	int		pts[EZ_PTS_MAX<<1]; /* progress timestamp array */
 	int		pidx;		/* PTS array index */
+	SMM_TIME	ptslast;	/* the last PTS timestamp */
 
 	int64_t		keygap;		/* maximum DTS between keyframe */
 	int64_t		keydts;		/* avarage DTS per key frame */
@@ -615,6 +768,12 @@ typedef	struct	_EzVid	{
 	int64_t		keylast;	/* the DTS of recent keyframe */
 	unsigned	keycount;	/* received keyframes since reset */
 	int64_t		keydelta;	/* the delta DTS of snapshots */
+	EZKEY		*keyidx;	/* key frame index by the full scan */
+	int		keynum;		/* entries in the key frame index */
+	int		keymax;		/* allocated entries (-1=broken) */
+	int64_t		skipto;		/* skip decoding frames before it */
+	int		skipping;	/* the decoder is skipping frames */
+	EZSTAT		stat;		/* the counters of all sessions */
 
 	struct	_EzVid	*anchor;	/* always pointing to the anchor */
 	struct	_EzVid	*next;
@@ -666,7 +825,11 @@ int ezthumb_bind(char **filename, int fnum, EZOPT *ezopt);
 int ezinfo(char *filename, EZOPT *ezopt, EZVID *vout);
 int ezthumb_break(EZOPT *ezopt);
 int eznotify(EZOPT *ezopt, int event, long param, long opt, void *block);
+unsigned long long ezopt_event_interest(EZOPT *ezopt, 
+		unsigned long long interest);
 int ezopt_store_config(EZOPT *ezopt, void *config);
+int ezopt_atlas_setup(EZOPT *ezopt);
+int ezopt_atlas_free(EZOPT *ezopt);
 char *video_media_in_buffer(EZVID *vidx, char *buf, int blen);
 
 /* ezutil.c */
@@ -688,6 +851,7 @@ int meta_make_color(char *s, EZBYTE *color);
 int meta_export_color(EZBYTE *color, char *buf, int blen);
 char *meta_make_fontdir(char *s);
 int meta_transparent_option(EZOPT *opt, int flag);
+char *meta_json_string(char *s, char *buf, int blen);
 
 /* ezttf.c */
 int ezttf_open(void);
@@ -765,3 +765,43 @@ int meta_transparent_option(EZOPT *opt, int flag)
 	return (opt->flags & EZOP_TRANSPARENT);
 }
 
+
+/* 20181018 quote the string for JSON. The control characters are escaped
+ * and the UTF-8 characters are kept as they are. The string would be 
+ * truncated if the buffer is too small */
+char *meta_json_string(char *s, char *buf, int blen)
+{
+	int	i = 0;
+
+	if (blen < 3) {
+		return NULL;
+	}
+	buf[i++] = '"';
+	for ( ; *s && (i < blen - 8); s++) {
+		switch (*s) {
+		case '"':
+		case '\\':
+			buf[i++] = '\\';
+			buf[i++] = *s;
+			break;
+		case '\n':
+			buf[i++] = '\\';
+			buf[i++] = 'n';
+			break;
+		case '\t':
+			buf[i++] = '\\';
+			buf[i++] = 't';
+			break;
+		default:
+			if ((unsigned char) *s < 0x20) {
+				i += sprintf(buf + i, "\\u%04x", *s);
+			} else {
+				buf[i++] = *s;
+			}
+			break;
+		}
+	}
+	buf[i++] = '"';
+	buf[i] = 0;
+	return buf;
+}
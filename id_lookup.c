@@ -226,11 +226,28 @@ struct	idtbl	id_mprocess[] = {
 	{ EZOP_PROC_SKIM,    "Upon Key Frames" },
 	{ EZOP_PROC_SCAN,    "Single Pass" },
 	{ EZOP_PROC_TWOPASS, "Two Pass" },
+	{ EZOP_PROC_ONEPASS, "One Pass Accurate" },
 	{ EZOP_PROC_SAFE,    "Safe Mode" },
 	{ EZOP_PROC_KEYRIP,  "Key Frame Rip" },
 	{ 0, NULL }
 };
 
+struct	idtbl	id_threading[] = {
+	{ EZOP_THREAD_AUTO,  CFG_PIC_AUTO },
+	{ EZOP_THREAD_FRAME, "Frame" },
+	{ EZOP_THREAD_SLICE, "Slice" },
+	{ EZOP_THREAD_OFF,   "Off" },
+	{ 0, NULL }
+};
+
+struct	idtbl	id_scaling[] = {
+	{ EZOP_SCALE_AUTO,     CFG_PIC_AUTO },
+	{ EZOP_SCALE_FAST,     "Fast" },
+	{ EZOP_SCALE_BALANCED, "Balanced" },
+	{ EZOP_SCALE_BEST,     "Best" },
+	{ 0, NULL }
+};
+
 
 
 #ifdef	HAVE_AVCODEC_DESCRIPTOR_GET
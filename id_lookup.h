@@ -32,6 +32,8 @@ extern	struct	idtbl	id_layout[];
 extern	struct	idtbl	id_duration_long[];
 extern	struct	idtbl	id_existed[];
 extern	struct	idtbl	id_mprocess[];
+extern	struct	idtbl	id_threading[];
+extern	struct	idtbl	id_scaling[];
 
 char *id_lookup(struct idtbl *table, int id);
 char *id_lookup_tail(struct idtbl *table, int id);
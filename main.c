@@ -59,6 +59,10 @@
 #endif
 
 #include <ctype.h>
+#include <stdarg.h>
+#ifdef	HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 #include "ezthumb.h"
 #include "id_lookup.h"
@@ -99,6 +103,17 @@
 #define CMD_TIME_END	21
 #define CMD_TRANSPRT	22
 #define CMD_VID_IDX	23
+#define CMD_JOBS	24
+#define CMD_THREADS	25
+#define CMD_PROBE	26
+#define CMD_LOWRES	27
+#define CMD_SEEKERS	28
+#define CMD_SCALE	29
+#define CMD_BANDED	30
+#define CMD_GIF_PAL	31
+#define CMD_PROG_RATE	32
+#define CMD_STATS	33
+#define CMD_IO		34
 
 #define CMD_B_IND	'b'
 #define CMD_C_OLOR	'c'
@@ -133,11 +148,36 @@ static	struct	idtbl	id_process[] = {
 	{ EZOP_PROC_SKIM,    "skim" },
 	{ EZOP_PROC_SCAN,    "scan" },
 	{ EZOP_PROC_TWOPASS, "2pass" },
+	{ EZOP_PROC_ONEPASS, "1pass" },
 	{ EZOP_PROC_SAFE,    "safe" },
 	{ EZOP_PROC_KEYRIP,  "key" },
 	{ 0, NULL }
 };
 
+static	struct	idtbl	id_thread[] = {
+	{ EZOP_THREAD_AUTO,  "auto" },
+	{ EZOP_THREAD_FRAME, "frame" },
+	{ EZOP_THREAD_SLICE, "slice" },
+	{ EZOP_THREAD_OFF,   "off" },
+	{ 0, NULL }
+};
+
+static	struct	idtbl	id_scale[] = {
+	{ EZOP_SCALE_AUTO,     "auto" },
+	{ EZOP_SCALE_FAST,     "fast" },
+	{ EZOP_SCALE_BALANCED, "balanced" },
+	{ EZOP_SCALE_BEST,     "best" },
+	{ 0, NULL }
+};
+
+static	struct	idtbl	id_io[] = {
+	{ EZ_IO_AUTO,   "auto" },
+	{ EZ_IO_FFMPEG, "ffmpeg" },
+	{ EZ_IO_BUFFER, "buffer" },
+	{ EZ_IO_MMAP,   "mmap" },
+	{ 0, NULL }
+};
+
 static	struct	cliopt	clist[] = {
 	{ 0, NULL, 0, "Usage: ezthumb [OPTIONS] video_clip ..." },
 	{ 0, NULL, 0, "OPTIONS:" },
@@ -168,7 +208,7 @@ static	struct	cliopt	clist[] = {
 	{ CMD_O_UTPUT, "outdir",  
 		1, "the directory for storing output images" },
 	{ CMD_P_ROCESS, "process", 
-		1, "the process method (skim|scan|2pass|safe|key[@N])"},
+		1, "the process method (skim|scan|1pass|2pass|safe|key[@N])"},
 	{ CMD_P_ROFILE, "profile", 
 		1, "specify the profile string" },
 	{ CMD_R_ECURS, "recursive", 
@@ -224,6 +264,28 @@ static	struct	cliopt	clist[] = {
 		0, "recover to the default settings" },
 	{ CMD_VID_IDX, "vindex",
 		1, "*the index of the video stream" },
+	{ CMD_JOBS, "jobs",
+		1, "*number of files processed concurrently (1)(0=auto)" },
+	{ CMD_THREADS, "threads",
+		1, "*decoder threading (auto)(frame|slice|off)[@N]" },
+	{ CMD_PROBE, "probe-cache",
+		1, "*cache the media probe results (off)(on|off)" },
+	{ CMD_LOWRES, "lowres",
+		1, "*decode in low resolution for small shots (off)(on|off)" },
+	{ CMD_SEEKERS, "seekers",
+		1, "*demuxers taking shots in parallel in a file (1)(0=auto)" },
+	{ CMD_SCALE, "scale",
+		1, "*quality of the scaler (best)(auto|fast|balanced)" },
+	{ CMD_BANDED, "banded",
+		1, "*keep only a band of the canvas in memory (off)(on|off)" },
+	{ CMD_GIF_PAL, "gif-palette",
+		1, "*palette of the animated GIF (local)(local|global)" },
+	{ CMD_PROG_RATE, "progress-rate",
+		1, "*minimum interval of the progress report (100)(ms)" },
+	{ CMD_STATS, "stats",
+		1, "*append the counters of each video as JSON lines (-=stdout)" },
+	{ CMD_IO, "io",
+		1, "*I/O backend of local files (auto)(ffmpeg|buffer|mmap)" },
 	{ CMD_HELP, "help",
 		0, "*Display the help message" },
 	{ CMD_VERSION, "version", 
@@ -289,6 +351,47 @@ static	char	*sysprof[] = {
 
 static	EZOPT	sysopt;
 
+#ifdef	HAVE_PTHREAD_H
+/* The job mode processes multiple video files concurrently. Each worker
+ * owns a private copy of the EZOPT so the runtime objects, vidobj and 
+ * imgobj, won't be shared. Other members in the EZOPT are read only.
+ * The progress report of each file is buffered in its job slot and 
+ * printed in the order of the file list so the output is deterministic */
+#define EZJOB_WAIT	0
+#define EZJOB_RUN	1
+#define EZJOB_DONE	2
+
+typedef	struct	{
+	char	*filename;
+	char	*report;	/* buffered progress report */
+	int	rpsize;		/* allocated size of the report buffer */
+	int	rplen;		/* used size of the report buffer */
+	int	state;		/* EZJOB_WAIT, EZJOB_RUN and EZJOB_DONE */
+	int	rc;		/* returned value of ezthumb() */
+} EZJOB;
+
+typedef	struct	{
+	EZOPT		opt;	/* private copy, must be the first member */
+	pthread_t	tid;
+	void		*pool;
+	EZJOB		*job;	/* the current job */
+} EZWORK;
+
+typedef	struct	{
+	pthread_mutex_t	lock;	/* protect the job queue */
+	pthread_mutex_t	ntf;	/* serialize the passthrough events */
+	pthread_cond_t	done;	/* signal the main thread a job finished */
+	EZJOB		*jobs;
+	int		jnum;	/* number of queued jobs */
+	int		jmax;	/* size of the job array */
+	int		jnext;	/* index of the next waiting job */
+	EZWORK		*work;
+	int		wnum;	/* number of workers */
+} EZPOOL;
+
+static	EZPOOL	*jobpool;	/* registered for signal breaking */
+#endif
+
 static int command_line_parser(int argc, char **argv, EZOPT *opt);
 static int signal_handler(int sig);
 static int main_close(EZOPT *opt);
@@ -306,6 +409,15 @@ static int event_cb(void *vobj, int event, long param, long opt, void *block);
 static int event_verbose(void *vobj, int event, long param, long opt, void *);
 static int event_list(void *vobj, int event, long param, long opt, void *);
 static void version_ffmpeg(void);
+#ifdef	HAVE_PTHREAD_H
+static int job_main(int argc, char **argv, EZOPT *ezopt);
+static int job_pool_add(EZPOOL *pool, char *cwd, char *path);
+static int job_pool_run(EZPOOL *pool, EZOPT *ezopt);
+static void *job_worker(void *arg);
+static int job_printf(EZJOB *job, char *fmt, ...);
+static int msg_job(void *option, char *path, int type, void *info);
+static int event_job(void *vobj, int event, long param, long opt, void *);
+#endif
 
 static int runtime_profile_test(EZOPT *opt, char *cmd);
 static void linefeed_count(int n, int mod, char *con, char *coff);
@@ -343,6 +455,14 @@ int main(int argc, char **argv)
 	}
 #endif
 	todo = command_line_parser(argc, argv, &sysopt);
+	/* the command line progress reports don't need the events of every
+	 * packet and frame. The GUI registers its own interest */
+	ezopt_event_interest(&sysopt, 0);
+	/* 20181018 tracing the packets and frames by the asynchronous 
+	 * logger so the logging won't change the timing too much */
+	if (EZOP_DEBUG(sysopt.flags) >= SLOG_LVL_PROGRAM) {
+		slog_bind_async(dbgc, 4096, 0);
+	}
 	CDB_DEBUG(("Todo: %c(%d) ARG=%d/%d\n", todo, todo, optind, argc));
 	CDB_DEBUG(("CodePage: %d\n", smm_sys_cp));
 	
@@ -410,6 +530,7 @@ int main(int argc, char **argv)
 #ifndef CFG_GUI_OFF
 		ezbar_init(&sysopt);
 #endif
+		ezopt_atlas_setup(&sysopt);
 		eznotify(&sysopt, EN_BATCH_BEGIN, 0, 0, NULL);
 		todo = ezthumb_bind(argv + optind, argc - optind, &sysopt);
 		eznotify(&sysopt, EN_BATCH_END, 0, 0, NULL);
@@ -426,6 +547,15 @@ int main(int argc, char **argv)
 #endif
 		break;
 	default:
+		/* 20181018 render the glyphs of the timestamp once in the run,
+		 * before the workers start, so they won't run FreeType together */
+		ezopt_atlas_setup(&sysopt);
+#ifdef	HAVE_PTHREAD_H
+		if (sysopt.jobs != 1) {
+			todo = job_main(argc, argv, &sysopt);
+			break;
+		}
+#endif
 		/* inject the progress report functions */
 		if (EZOP_DEBUG(sysopt.flags) < SLOG_LVL_DEBUG) {
 			sysopt.notify = event_cb;
@@ -454,6 +584,7 @@ int main(int argc, char **argv)
 	}
 	main_close(&sysopt);
 	ezttf_close();	/* closing is safe */
+	slog_csoup_close();	/* drain the asynchronous logger */
 	smm_destroy();
 	return todo;
 }
@@ -620,6 +751,102 @@ static int command_line_parser(int argc, char **argv, EZOPT *opt)
 				opt->vs_user = strtol(optarg, NULL, 0);
 			}
 			break;
+		case CMD_JOBS:	/* number of concurrent jobs */
+			if (!isdigit(*optarg)) {
+				todo = CMD_ERROR;  /* command line error */
+				goto break_parse;  /* break the analysis */
+			} else {
+				opt->jobs = strtol(optarg, NULL, 0);
+			}
+			break;
+		case CMD_PROG_RATE:	/* interval of progress events */
+			if (!isdigit(*optarg)) {
+				todo = CMD_ERROR;  /* command line error */
+				goto break_parse;  /* break the analysis */
+			} else {
+				opt->ev_rate = strtol(optarg, NULL, 0);
+			}
+			break;
+		case CMD_STATS:		/* statistics of each video */
+			opt->stats = optarg;
+			break;
+		case CMD_IO:		/* I/O backend of local files */
+			c = lookup_idnum_string(id_io, -1, optarg);
+			if (c == -1) {
+				todo = CMD_ERROR; /* command line error */
+				goto break_parse; /* break the analysis */
+			}
+			opt->io_mode = c;
+			break;
+		case CMD_SEEKERS:	/* number of parallel seekers */
+			if (!isdigit(*optarg)) {
+				todo = CMD_ERROR;  /* command line error */
+				goto break_parse;  /* break the analysis */
+			} else {
+				opt->seekers = strtol(optarg, NULL, 0);
+			}
+			break;
+		case CMD_SCALE:		/* scaler quality tier */
+			c = lookup_idnum_string(id_scale, -1, optarg);
+			if (c == -1) {
+				todo = CMD_ERROR; /* command line error */
+				goto break_parse; /* break the analysis */
+			}
+			EZOP_SCALE_SET(opt->flags, c);
+			break;
+		case CMD_THREADS:	/* decoder threading: slice@4 */
+			csc_strlcpy(tmp, optarg, sizeof(tmp));
+			if ((p = strchr(tmp, '@')) != NULL) {
+				*p++ = 0;
+				opt->dec_threads = (int)strtol(p, NULL, 0);
+			}
+			c = lookup_idnum_string(id_thread, -1, tmp);
+			if (c == -1) {
+				todo = CMD_ERROR; /* command line error */
+				goto break_parse; /* break the analysis */
+			}
+			EZOP_THREAD_SET(opt->flags, c);
+			break;
+		case CMD_PROBE:	/* probe-cache */
+			if (!strcmp(optarg, "on")) {
+				opt->flags |= EZOP_PROBE_CACHE;
+			} else if (!strcmp(optarg, "off")) {
+				opt->flags &= ~EZOP_PROBE_CACHE;
+			} else {
+				todo = CMD_ERROR;  /* command line error */
+				goto break_parse;  /* break the analysis */
+			}
+			break;
+		case CMD_BANDED:	/* banded canvas */
+			if (!strcmp(optarg, "on")) {
+				opt->flags |= EZOP_BANDED;
+			} else if (!strcmp(optarg, "off")) {
+				opt->flags &= ~EZOP_BANDED;
+			} else {
+				todo = CMD_ERROR;  /* command line error */
+				goto break_parse;  /* break the analysis */
+			}
+			break;
+		case CMD_GIF_PAL:	/* palette of the GIF animation */
+			if (!strcmp(optarg, "local")) {
+				opt->gif_palette = EZ_GIFPAL_LOCAL;
+			} else if (!strcmp(optarg, "global")) {
+				opt->gif_palette = EZ_GIFPAL_GLOBAL;
+			} else {
+				todo = CMD_ERROR;  /* command line error */
+				goto break_parse;  /* break the analysis */
+			}
+			break;
+		case CMD_LOWRES:	/* lowres */
+			if (!strcmp(optarg, "on")) {
+				opt->flags |= EZOP_LOWRES;
+			} else if (!strcmp(optarg, "off")) {
+				opt->flags &= ~EZOP_LOWRES;
+			} else {
+				todo = CMD_ERROR;  /* command line error */
+				goto break_parse;  /* break the analysis */
+			}
+			break;
 
 		case CMD_OVERRIDE:
 			if (!strcmp(optarg, "on")) {
@@ -888,6 +1115,15 @@ break_parse:
 static int signal_handler(int sig)
 {
 	CDB_WARN(("Signal %d\n", sig));
+#ifdef	HAVE_PTHREAD_H
+	if (jobpool) {
+		int	i;
+
+		for (i = 0; i < jobpool->wnum; i++) {
+			ezthumb_break(&jobpool->work[i].opt);
+		}
+	}
+#endif
 	sig = ezthumb_break(&sysopt);
 	main_close(&sysopt);
 	ezttf_close();	/* closing is safe */
@@ -919,6 +1155,7 @@ static int main_close(EZOPT *opt)
 		smm_free(opt->background);
 		opt->background = NULL;
 	}
+	ezopt_atlas_free(opt);
 	return 0;
 }
 
@@ -1333,6 +1570,319 @@ static int event_list(void *vobj, int event,
 	return event;
 }
 
+#ifdef	HAVE_PTHREAD_H
+/* process the video files by a pool of workers. The file list will be 
+ * queued first so the reports could be printed in the same order as the
+ * serial mode does */
+static int job_main(int argc, char **argv, EZOPT *ezopt)
+{
+	EZPOOL	*pool;
+	int	i, rc;
+
+	if ((pool = smm_alloc(sizeof(EZPOOL))) == NULL) {
+		return EZ_ERR_LOWMEM;
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_mutex_init(&pool->ntf, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	if ((ezopt->flags & EZOP_RECURSIVE) == 0) {
+		for (i = optind; i < argc; i++) {
+			job_pool_add(pool, NULL, argv[i]);
+		}
+	} else if (optind >= argc) {
+		smm_pathtrek(".", ezopt->r_flags, msg_job, pool);
+	} else {
+		for (i = optind; i < argc; i++) {
+			smm_pathtrek(argv[i], ezopt->r_flags, msg_job, pool);
+		}
+	}
+
+	/* 0 means one job per online processor */
+	if (ezopt->jobs <= 0) {
+#ifdef	_SC_NPROCESSORS_ONLN
+		ezopt->jobs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		if (ezopt->jobs <= 0) {
+			ezopt->jobs = 1;
+		}
+	}
+	if (ezopt->jobs > pool->jnum) {
+		ezopt->jobs = pool->jnum;
+	}
+	CDB_DEBUG(("Jobs: %d workers for %d files\n", ezopt->jobs, pool->jnum));
+
+	eznotify(ezopt, EN_BATCH_BEGIN, 0, 0, NULL);
+	rc = job_pool_run(pool, ezopt);
+	eznotify(ezopt, EN_BATCH_END, 0, 0, NULL);
+
+	for (i = 0; i < pool->jnum; i++) {
+		if (rc == EZ_ERR_NONE) {
+			rc = pool->jobs[i].rc;	/* the last one like serial */
+		}
+		smm_free(pool->jobs[i].filename);
+		if (pool->jobs[i].report) {
+			smm_free(pool->jobs[i].report);
+		}
+	}
+	if (pool->jobs) {
+		smm_free(pool->jobs);
+	}
+	if (pool->work) {
+		smm_free(pool->work);
+	}
+	pthread_cond_destroy(&pool->done);
+	pthread_mutex_destroy(&pool->ntf);
+	pthread_mutex_destroy(&pool->lock);
+	smm_free(pool);
+	return rc;
+}
+
+static int job_pool_add(EZPOOL *pool, char *cwd, char *path)
+{
+	EZJOB	*job;
+	int	len;
+
+	if (pool->jnum >= pool->jmax) {
+		len = pool->jmax + 256;
+		if ((job = smm_alloc(sizeof(EZJOB) * len)) == NULL) {
+			return EZ_ERR_LOWMEM;
+		}
+		if (pool->jobs) {
+			memcpy(job, pool->jobs, sizeof(EZJOB) * pool->jnum);
+			smm_free(pool->jobs);
+		}
+		pool->jobs = job;
+		pool->jmax = len;
+	}
+
+	job = &pool->jobs[pool->jnum];
+	if (cwd == NULL) {
+		job->filename = csc_strcpy_alloc(path, 0);
+	} else if ((job->filename = 
+			csc_strcpy_alloc(cwd, strlen(path) + 4)) != NULL) {
+		len = strlen(job->filename);
+		if (len && !csc_isdelim(SMM_PATH_DELIM, job->filename[len-1])) {
+			strcat(job->filename, SMM_DEF_DELIM);
+		}
+		strcat(job->filename, path);
+	}
+	if (job->filename == NULL) {
+		return EZ_ERR_LOWMEM;
+	}
+	job->state = EZJOB_WAIT;
+	pool->jnum++;
+	return EZ_ERR_NONE;
+}
+
+static int job_pool_run(EZPOOL *pool, EZOPT *ezopt)
+{
+	EZWORK	*work;
+	EZJOB	*job;
+	int	i;
+
+	if (pool->jnum == 0) {
+		return EZ_ERR_NONE;
+	}
+	if ((pool->work = smm_alloc(sizeof(EZWORK) * ezopt->jobs)) == NULL) {
+		return EZ_ERR_LOWMEM;
+	}
+
+	/* the FreeType font cache in libgd must be set up before threads */
+	gdFontCacheSetup();
+
+	jobpool = pool;
+	for (i = 0; i < ezopt->jobs; i++) {
+		work = &pool->work[pool->wnum];
+		memcpy(&work->opt, ezopt, sizeof(EZOPT));
+		work->opt.notify = event_job;
+		work->opt.vidobj = NULL;
+		work->opt.imgobj = NULL;
+		work->pool = pool;
+		if (pthread_create(&work->tid, NULL, job_worker, work)) {
+			CDB_WARN(("Failed to create worker %d\n", i));
+			break;
+		}
+		pool->wnum++;
+	}
+	if (pool->wnum == 0) {
+		jobpool = NULL;
+		return EZ_ERR_LOWMEM;
+	}
+
+	/* print the reports in the order of the file list */
+	pthread_mutex_lock(&pool->lock);
+	for (i = 0; i < pool->jnum; i++) {
+		job = &pool->jobs[i];
+		while (job->state != EZJOB_DONE) {
+			pthread_cond_wait(&pool->done, &pool->lock);
+		}
+		if (job->report) {
+			pthread_mutex_lock(&pool->ntf);
+			CDB_SHOW(("%s", job->report));
+			pthread_mutex_unlock(&pool->ntf);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < pool->wnum; i++) {
+		pthread_join(pool->work[i].tid, NULL);
+	}
+	jobpool = NULL;
+	return EZ_ERR_NONE;
+}
+
+static void *job_worker(void *arg)
+{
+	EZWORK	*work = arg;
+	EZPOOL	*pool = work->pool;
+	EZJOB	*job;
+
+	while (1) {
+		pthread_mutex_lock(&pool->lock);
+		if (pool->jnext >= pool->jnum) {
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		job = &pool->jobs[pool->jnext++];
+		job->state = EZJOB_RUN;
+		pthread_mutex_unlock(&pool->lock);
+
+		work->job = job;
+		job->rc = ezthumb(job->filename, &work->opt);
+		work->job = NULL;
+
+		pthread_mutex_lock(&pool->lock);
+		job->state = EZJOB_DONE;
+		pthread_cond_signal(&pool->done);
+		pthread_mutex_unlock(&pool->lock);
+	}
+	return NULL;
+}
+
+static int job_printf(EZJOB *job, char *fmt, ...)
+{
+	va_list	ap;
+	char	*p;
+	int	n, len;
+
+	va_start(ap, fmt);
+	n = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	if (n <= 0) {
+		return n;
+	}
+
+	if (job->rplen + n + 1 > job->rpsize) {
+		len = job->rplen + n + 256;
+		if ((p = smm_alloc(len)) == NULL) {
+			return EZ_ERR_LOWMEM;
+		}
+		if (job->report) {
+			memcpy(p, job->report, job->rplen);
+			smm_free(job->report);
+		}
+		job->report = p;
+		job->rpsize = len;
+	}
+
+	va_start(ap, fmt);
+	vsnprintf(job->report + job->rplen, job->rpsize - job->rplen, fmt, ap);
+	va_end(ap);
+	job->rplen += n;
+	return n;
+}
+
+static int msg_job(void *option, char *path, int type, void *info)
+{
+	char	*cwd;
+
+	(void) info;	/* stop the gcc warning */
+
+	switch (type) {
+	case SMM_MSG_PATH_ENTER:
+		CDB_SHOW(("Entering %s:\n", path));
+		break;
+	case SMM_MSG_PATH_EXEC:
+		if (csc_extname_filter_match(sysopt.accept, path)) {
+			/* smm_pathtrek() had changed the current working
+			 * directory so the full path must be queued */
+			if ((cwd = smm_cwd_alloc(0)) != NULL) {
+				job_pool_add(option, cwd, path);
+				smm_free(cwd);
+			}
+		}
+		break;
+	case SMM_MSG_PATH_BREAK:
+		CDB_WARN(("Failed to process %s\n", path));
+		break;
+	case SMM_MSG_PATH_LEAVE:
+		CDB_SHOW(("Leaving %s\n", path));
+		break;
+	}
+	return SMM_NTF_PATH_NONE;
+}
+
+/* The progress reports were buffered in the job slot. The progress bar
+ * can not be displayed by concurrent workers so it's been ignored. 
+ * Other events are passed to the default handler one by one */
+static int event_job(void *vobj, int event, 
+		long param, long opt, void *block)
+{
+	EZWORK	*work = vobj;
+	EZPOOL	*pool = work->pool;
+	struct	ezntf	*myntf;
+	EZVID	*vidx;
+	EZIMG	*image;
+	int	rc;
+
+	switch (event) {
+	case EN_OPEN_BEGIN:
+		vidx = block;
+		job_printf(work->job, "Triaging %s ... ", vidx->filename);
+		break;
+	case EN_OPEN_END:
+		if ((vidx = block) != NULL) {
+			job_printf(work->job, "%dx%d %lld (ms)\n", vidx->width,
+				vidx->height, (long long) vidx->duration);
+		} else if (param == EZ_ERR_VIDEOSTREAM) {
+			job_printf(work->job, "no media\n");
+		} else {
+			job_printf(work->job, "skip\n");
+		}
+		break;
+	case EN_PROC_BEGIN:
+	case EN_PROC_BINDING:
+	case EN_PROC_CURRENT:
+		break;
+	case EN_PROC_END:
+		if (param == 0) {       /* for key frame saving only */
+			job_printf(work->job, "Building done\n");
+		} else {
+			job_printf(work->job, "Building %ldx%ld done\n", 
+					param, opt);
+		}
+		break;
+	case EN_PROC_SAVED:
+		myntf = block;
+		image = myntf->varg2;
+		job_printf(work->job, "OUTPUT: %s\n", image->filename);
+		break;
+	case EN_SKIP_EXIST:
+		job_printf(work->job, "Thumbnail Existed: %s\n", (char*)block);
+		break;
+	default:
+		pthread_mutex_lock(&pool->ntf);
+		work->opt.notify = NULL;
+		rc = eznotify(&work->opt, event, param, opt, block);
+		work->opt.notify = event_job;
+		pthread_mutex_unlock(&pool->ntf);
+		return rc;
+	}
+	return event;
+}
+#endif	/* HAVE_PTHREAD_H */
+
 static void version_ffmpeg(void)
 {
 	printf("FFMPEG: libavcodec %d.%d.%d; ", LIBAVCODEC_VERSION_MAJOR,